@@ -0,0 +1,361 @@
+// Benchmark of the renderer: renders scene files and synthetic scenes at
+// several resolutions and thread counts, a number of times each, and
+// reports the median and 95th percentile render time and the Mrays/s.
+// The results are printed as a table and written as JSON, e.g.
+//
+//      bench --resolution 400x400,1920x1080 --threads 1,4
+//            --spheres 10000 --json base.json ../Scenes
+//
+// Scene files refer to their models relative to the working directory,
+// run it from the Scenes directory for those to be found.
+
+#include "image.h"
+#include "light.h"
+#include "raytracer.h"
+#include "scene.h"
+#include "shapes/sphere.h"
+#include "shapes/trianglemesh.h"
+
+#include "json/json.h"
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace
+{
+    struct Resolution
+    {
+        unsigned width;
+        unsigned height;
+    };
+
+    struct Options
+    {
+        vector<Resolution> resolutions;
+        vector<unsigned> threads;
+        vector<unsigned> spheres;       // synthetic scenes
+        vector<unsigned> triangles;
+        vector<string> scenes;          // files or directories
+        unsigned repeat = 5;
+        unsigned warmup = 1;
+        bool packets = false;
+        string jsonFile = "bench.json";
+    };
+
+    // "a,b,c" as a list of numbers
+    vector<unsigned> parseList(string const &value)
+    {
+        vector<unsigned> list;
+        istringstream in(value);
+        string item;
+        while (getline(in, item, ','))
+            list.push_back(stoul(item));
+        return list;
+    }
+
+    vector<Resolution> parseResolutions(string const &value)
+    {
+        vector<Resolution> list;
+        istringstream in(value);
+        string item;
+        while (getline(in, item, ','))
+        {
+            size_t sep = item.find('x');
+            if (sep == string::npos)
+                throw invalid_argument("resolution " + item);
+            list.push_back(Resolution{unsigned(stoul(item.substr(0, sep))),
+                                      unsigned(stoul(item.substr(sep + 1)))});
+        }
+        return list;
+    }
+
+    bool endsWith(string const &str, string const &suffix)
+    {
+        return str.size() >= suffix.size()
+            && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // an animation (see animation.h) rather than a scene: "Frames" or
+    // "Scenes" and no "Objects"
+    bool isAnimation(string const &filename)
+    {
+        ifstream in(filename);
+        json root = json::parse(in, nullptr, false);
+        return root.is_object() && !root.count("Objects")
+            && (root.count("Frames") || root.count("Scenes"));
+    }
+
+    // the .json scene files of a directory (not animations), sorted, or
+    // the file itself
+    vector<string> sceneFiles(string const &path)
+    {
+        DIR *dir = opendir(path.c_str());
+        if (!dir)
+            return vector<string>(1, path);
+
+        vector<string> files;
+        while (dirent *entry = readdir(dir))
+        {
+            string name(entry->d_name);
+            if (endsWith(name, ".json") && !isAnimation(path + '/' + name))
+                files.push_back(path + '/' + name);
+        }
+        closedir(dir);
+        sort(files.begin(), files.end());
+        return files;
+    }
+
+    Material syntheticMaterial(mt19937 &rng)
+    {
+        uniform_real_distribution<double> unit(0.0, 1.0);
+        return Material(Color(unit(rng), unit(rng), unit(rng)), 0.2, 0.7, 0.5, 32);
+    }
+
+    // the default camera looks at the 400 x 400 square at z = 0 from
+    // z = 1000, synthetic scenes fill the box in front of that square
+    void addSyntheticLights(Scene &scene)
+    {
+        scene.addLight(Light(Point(-200, 600, 1500), Color(0.4, 0.4, 0.8)));
+        scene.addLight(Light(Point(600, 600, 1500), Color(0.8, 0.8, 0.4)));
+    }
+
+    void makeSpheres(Scene &scene, unsigned count)
+    {
+        mt19937 rng(count);
+        uniform_real_distribution<double> coord(0.0, 400.0);
+        double radius = 200.0 / cbrt(double(count));   // roughly constant coverage
+        for (unsigned idx = 0; idx != count; ++idx)
+        {
+            Sphere *obj = scene.addObject<Sphere>(
+                Point(coord(rng), coord(rng), coord(rng) - 200), radius);
+            obj->material = syntheticMaterial(rng);
+        }
+        addSyntheticLights(scene);
+        scene.buildAccelerationStructure();
+    }
+
+    // a triangle soup as one mesh
+    void makeTriangles(Scene &scene, unsigned count)
+    {
+        mt19937 rng(count);
+        uniform_real_distribution<double> coord(0.0, 400.0);
+        double size = 400.0 / cbrt(double(count));
+        uniform_real_distribution<double> offset(-size, size);
+
+        TriangleMesh *mesh = scene.addObject<TriangleMesh>();
+        mesh->reserve(count);
+        for (unsigned idx = 0; idx != count; ++idx)
+        {
+            Point v0(coord(rng), coord(rng), coord(rng) - 200);
+            Point v1(v0 + Vector(offset(rng), offset(rng), offset(rng)));
+            Point v2(v0 + Vector(offset(rng), offset(rng), offset(rng)));
+            mesh->addTriangle(v0, v1, v2);
+        }
+        mesh->build();
+        mesh->material = syntheticMaterial(rng);
+        addSyntheticLights(scene);
+        scene.buildAccelerationStructure();
+    }
+
+    // nearest rank percentile of sorted values
+    double percentile(vector<double> const &sorted, double pct)
+    {
+        size_t rank = static_cast<size_t>(ceil(pct / 100.0 * sorted.size()));
+        return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+    }
+
+    // render the scene in all configurations, appending to results
+    void benchmark(string const &name, Scene &scene, Options const &options,
+                   json &results)
+    {
+        Camera const &camera = scene.getCamera();
+        vector<Resolution> resolutions(options.resolutions);
+        if (resolutions.empty())
+            resolutions.push_back(Resolution{camera.viewWidth, camera.viewHeight});
+
+        for (Resolution const &res : resolutions)
+            for (unsigned threads : options.threads)
+            {
+                scene.setThreads(threads);
+                Image img(res.width, res.height);
+
+                vector<double> seconds;
+                unsigned long long rays = 0;
+                for (unsigned run = 0; run != options.warmup + options.repeat; ++run)
+                {
+                    auto start = chrono::steady_clock::now();
+                    scene.render(img);
+                    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+                    if (run >= options.warmup)
+                        seconds.push_back(elapsed.count());
+                    rays = scene.rayCounters().totalRays();
+                }
+                sort(seconds.begin(), seconds.end());
+
+                double median = percentile(seconds, 50);
+                double p95 = percentile(seconds, 95);
+                double mrays = rays / median * 1e-6;
+
+                cout << left << setw(40) << name << right
+                     << setw(6) << res.width << 'x' << setw(5) << left << res.height
+                     << right << setw(4) << threads
+                     << fixed << setprecision(4)
+                     << setw(10) << median << setw(10) << p95
+                     << setprecision(2) << setw(10) << mrays << '\n';
+
+                json entry;
+                entry["scene"] = name;
+                entry["width"] = res.width;
+                entry["height"] = res.height;
+                entry["threads"] = threads;
+                entry["runs"] = seconds.size();
+                entry["seconds"] = seconds;
+                entry["median"] = median;
+                entry["p95"] = p95;
+                entry["rays"] = rays;
+                entry["mraysPerSecond"] = mrays;
+                results.push_back(entry);
+            }
+    }
+
+    void usage(char const *program)
+    {
+        cerr << "Usage: " << program << " [options] [scene.json | directory] ...\n\n"
+             << "Options:\n"
+             << "  --resolution WxH,...  render sizes (default: camera viewSize)\n"
+             << "  --threads N,...       thread counts (default: all cores)\n"
+             << "  --spheres N,...       synthetic scenes of N spheres\n"
+             << "  --triangles N,...     synthetic scenes of an N triangle mesh\n"
+             << "  --repeat N            timed runs per configuration (5)\n"
+             << "  --warmup N            untimed runs before those (1)\n"
+             << "  --packets             trace primary rays in SIMD packets\n"
+             << "  --json FILE           write the results to FILE (bench.json)\n";
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    try
+    {
+        for (int arg = 1; arg < argc; ++arg)
+        {
+            string option(argv[arg]);
+            bool hasValue = arg + 1 < argc;
+            if (option == "--resolution" && hasValue)
+                options.resolutions = parseResolutions(argv[++arg]);
+            else if (option == "--threads" && hasValue)
+                options.threads = parseList(argv[++arg]);
+            else if (option == "--spheres" && hasValue)
+                options.spheres = parseList(argv[++arg]);
+            else if (option == "--triangles" && hasValue)
+                options.triangles = parseList(argv[++arg]);
+            else if (option == "--repeat" && hasValue)
+                options.repeat = max(1UL, stoul(argv[++arg]));
+            else if (option == "--warmup" && hasValue)
+                options.warmup = stoul(argv[++arg]);
+            else if (option == "--packets")
+                options.packets = true;
+            else if (option == "--json" && hasValue)
+                options.jsonFile = argv[++arg];
+            else if (option.compare(0, 2, "--") == 0)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+            else
+                options.scenes.push_back(option);
+        }
+    }
+    catch (exception const &ex)
+    {
+        cerr << "Invalid option value: " << ex.what() << '\n';
+        return 1;
+    }
+
+    if (options.scenes.empty() && options.spheres.empty()
+        && options.triangles.empty())
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    if (options.threads.empty())
+        options.threads.push_back(max(1U, thread::hardware_concurrency()));
+
+    PacketKernels const *kernels =
+        options.packets ? selectPacketKernels(MAX_PACKET_WIDTH) : nullptr;
+
+    cout << left << setw(40) << "scene" << right << setw(12) << "size"
+         << setw(4) << "thr" << setw(10) << "median s" << setw(10) << "p95 s"
+         << setw(10) << "Mrays/s" << '\n';
+
+    json results = json::array();
+    for (string const &path : options.scenes)
+        for (string const &file : sceneFiles(path))
+        {
+            Raytracer raytracer;
+
+            // keep the loading messages out of the table
+            streambuf *coutBuf = cout.rdbuf(nullptr);
+            bool loaded = raytracer.readScene(file);
+            cout.rdbuf(coutBuf);
+            cout.clear();
+            if (!loaded)
+            {
+                cerr << "Skipping " << file << ": reading the scene failed.\n";
+                continue;
+            }
+
+            Scene &scene = raytracer.getScene();
+            scene.setPacketKernels(kernels);
+            benchmark(file, scene, options, results);
+        }
+
+    for (unsigned count : options.spheres)
+    {
+        Scene scene;
+        makeSpheres(scene, count);
+        scene.setPacketKernels(kernels);
+        benchmark("spheres:" + to_string(count), scene, options, results);
+    }
+
+    for (unsigned count : options.triangles)
+    {
+        Scene scene;
+        makeTriangles(scene, count);
+        scene.setPacketKernels(kernels);
+        benchmark("triangles:" + to_string(count), scene, options, results);
+    }
+
+    json report;
+    report["packets"] = kernels ? kernels->name : "scalar";
+    report["repeat"] = options.repeat;
+    report["warmup"] = options.warmup;
+    report["results"] = results;
+
+    ofstream out(options.jsonFile);
+    out << setw(4) << report << '\n';
+    if (!out)
+    {
+        cerr << "Could not write " << options.jsonFile << ".\n";
+        return 1;
+    }
+    cout << "Wrote " << options.jsonFile << ".\n";
+    return 0;
+}
@@ -0,0 +1,116 @@
+#ifndef AABB_H_
+#define AABB_H_
+
+#include "ray.h"
+#include "triple.h"
+
+#include <algorithm>
+#include <limits>
+
+// Axis aligned bounding box, used by the acceleration structures
+class AABB
+{
+    public:
+        Point min;
+        Point max;
+
+        // an empty box: extending it with anything yields that thing
+        AABB()
+        :
+            min(std::numeric_limits<Real>::infinity(),
+                std::numeric_limits<Real>::infinity(),
+                std::numeric_limits<Real>::infinity()),
+            max(-std::numeric_limits<Real>::infinity(),
+                -std::numeric_limits<Real>::infinity(),
+                -std::numeric_limits<Real>::infinity())
+        {}
+
+        AABB(Point const &lower, Point const &upper)
+        :
+            min(lower),
+            max(upper)
+        {}
+
+        // box of objects without a finite extent (e.g. planes)
+        static AABB infinite()
+        {
+            Real const inf = std::numeric_limits<Real>::infinity();
+            return AABB(Point(-inf, -inf, -inf), Point(inf, inf, inf));
+        }
+
+        // nothing was added, e.g. the box of a mesh without triangles
+        bool isEmpty() const
+        {
+            for (unsigned axis = 0; axis != 3; ++axis)
+                if (min.data[axis] > max.data[axis])
+                    return true;
+            return false;
+        }
+
+        // finite, empty boxes are bounded too (check isEmpty first)
+        bool isBounded() const
+        {
+            for (unsigned axis = 0; axis != 3; ++axis)
+                if (!(min.data[axis] > -std::numeric_limits<Real>::max()
+                      && max.data[axis] < std::numeric_limits<Real>::max()))
+                    return false;
+            return true;
+        }
+
+        void extend(Point const &p)
+        {
+            for (unsigned axis = 0; axis != 3; ++axis)
+            {
+                min.data[axis] = std::min(min.data[axis], p.data[axis]);
+                max.data[axis] = std::max(max.data[axis], p.data[axis]);
+            }
+        }
+
+        void extend(AABB const &box)
+        {
+            for (unsigned axis = 0; axis != 3; ++axis)
+            {
+                min.data[axis] = std::min(min.data[axis], box.min.data[axis]);
+                max.data[axis] = std::max(max.data[axis], box.max.data[axis]);
+            }
+        }
+
+        Point centroid() const
+        {
+            return Point(0.5 * (min.x + max.x),
+                         0.5 * (min.y + max.y),
+                         0.5 * (min.z + max.z));
+        }
+
+        // surface area, the cost measure of the SAH
+        Real area() const
+        {
+            Real dx = max.x - min.x;
+            Real dy = max.y - min.y;
+            Real dz = max.z - min.z;
+            if (dx < 0 || dy < 0 || dz < 0)
+                return 0.0;
+            return 2.0 * (dx * dy + dy * dz + dz * dx);
+        }
+
+        // Slab test. invD holds 1 / ray.D per axis. On a hit tNear is the
+        // distance at which the ray enters the box (clamped to 0).
+        // NaNs (0 * inf on a flat box) are dropped by the min/max order.
+        bool intersect(Ray const &ray, Vector const &invD, Real tMax,
+                       Real &tNear) const
+        {
+            Real t0 = 0.0;
+            Real t1 = tMax;
+            for (unsigned axis = 0; axis != 3; ++axis)
+            {
+                Real tA = (min.data[axis] - ray.O.data[axis]) * invD.data[axis];
+                Real tB = (max.data[axis] - ray.O.data[axis]) * invD.data[axis];
+                t0 = std::max(t0, std::min(tA, tB));
+                t1 = std::min(t1, std::max(tA, tB));
+            }
+            tNear = t0;
+            return t0 <= t1;
+        }
+};
+
+#endif
@@ -0,0 +1,9 @@
+#include "adaptive.h"
+
+Color heatColor(Real fraction)
+{
+    fraction = std::min(std::max(fraction, Real(0)), Real(1));
+    if (fraction < 0.5)
+        return Color(0, 2 * fraction, 1 - 2 * fraction);
+    return Color(2 * fraction - 1, 2 - 2 * fraction, 0);
+}
@@ -0,0 +1,76 @@
+#ifndef ADAPTIVE_H_
+#define ADAPTIVE_H_
+
+#include "triple.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Adaptive supersampling: every pixel starts with minSamples samples.
+// Pixels whose mean differs by more than contrast from a neighbour's get
+// edgeSamples samples, a few samples can miss an edge crossing the pixel
+// but its neighbours tell. Then every pixel gets minSamples more at a time
+// while the estimated error of its mean color is above threshold, up to
+// maxSamples. Pixels on flat surfaces or the background stop right away,
+// edges and highlights get the samples. The sample positions are those of
+// samplePosition (progressive.h).
+struct AdaptiveOptions
+{
+    unsigned minSamples = 4;
+    unsigned edgeSamples = 16;
+    unsigned maxSamples = 64;
+    Real threshold = 0.005;     // standard error of a channel (0 .. 1)
+    Real contrast = 0.05;       // difference of a channel (0 .. 1)
+};
+
+// Running mean and variance of the (clamped) samples of one pixel
+// (Welford's algorithm)
+class PixelEstimate
+{
+    Color d_mean;
+    Color d_m2;                 // sum of squared differences to the mean
+    unsigned d_count = 0;
+
+    public:
+        void add(Color sample)
+        {
+            sample.clamp();     // what is above 1 does not show
+            ++d_count;
+            Color delta = sample - d_mean;
+            d_mean += delta / d_count;
+            d_m2 += delta * (sample - d_mean);
+        }
+
+        Color const &mean() const
+        {
+            return d_mean;
+        }
+
+        unsigned count() const
+        {
+            return d_count;
+        }
+
+        // largest difference between the means over the channels
+        Real contrast(PixelEstimate const &other) const
+        {
+            Color delta = d_mean - other.d_mean;
+            return std::max(std::fabs(delta.r),
+                            std::max(std::fabs(delta.g), std::fabs(delta.b)));
+        }
+
+        // largest standard error of the mean over the channels
+        Real error() const
+        {
+            if (d_count < 2)
+                return 0;
+            Real variance = std::max(d_m2.r, std::max(d_m2.g, d_m2.b))
+                            / (d_count - 1);
+            return std::sqrt(variance / d_count);
+        }
+};
+
+// false color for a heat map: blue (0) over green to red (1)
+Color heatColor(Real fraction);
+
+#endif
@@ -0,0 +1,197 @@
+#include "animation.h"
+
+#include "shapes/meshinstance.h"
+
+#include "json/json.h"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+using json = nlohmann::json;
+
+namespace
+{
+    // name relative to dir, unless it is absolute
+    string relativeTo(string const &dir, string const &name)
+    {
+        return !name.empty() && name[0] == '/' ? name : dir + name;
+    }
+}
+
+Animation::Animation(string const &filename)
+{
+    ifstream in(filename);
+    if (!in)
+        throw runtime_error("Could not open animation " + filename);
+    json root;
+    in >> root;
+
+    size_t slash = filename.find_last_of('/');
+    string dir = slash == string::npos ? "" : filename.substr(0, slash + 1);
+
+    if (root.count("Scenes"))
+    {
+        for (json const &scene : root["Scenes"])
+            d_scenes.push_back(relativeTo(dir, scene));
+        d_frames = d_scenes.size();
+    }
+    else
+    {
+        d_scenes.push_back(relativeTo(dir, root["Scene"]));
+        d_frames = root["Frames"];
+        readKeys(root);
+    }
+    if (d_frames == 0)
+        throw runtime_error("Animation " + filename + " has no frames");
+
+    if (root.count("Output"))
+        d_output = relativeTo(dir, root["Output"]);
+}
+
+unsigned Animation::frames() const
+{
+    return d_frames;
+}
+
+string const &Animation::output() const
+{
+    return d_output;
+}
+
+bool Animation::sceneList() const
+{
+    return d_scenes.size() > 1;
+}
+
+string const &Animation::sceneFile(unsigned frame) const
+{
+    return d_scenes[sceneList() ? frame : 0];
+}
+
+bool Animation::apply(unsigned frame, Scene &scene,
+                      vector<MeshInstance *> const &instances,
+                      vector<Placement> const &placements) const
+{
+    if (!d_eye.empty() || !d_center.empty() || !d_up.empty()
+        || !d_fov.empty())
+    {
+        Camera const &current = scene.getCamera();
+        scene.setCamera(Camera(
+            d_eye.empty() ? current.eye : d_eye.at(frame),
+            d_center.empty() ? current.center : d_center.at(frame),
+            d_up.empty() ? current.up : d_up.at(frame),
+            current.viewWidth, current.viewHeight,
+            d_fov.empty() ? current.fov : d_fov.at(frame)));
+    }
+
+    for (LightTrack const &track : d_lights)
+    {
+        if (track.light >= scene.getLights().size())
+            throw runtime_error("Animation: no light "
+                                + to_string(track.light));
+        Light const &current = scene.getLights()[track.light];
+        scene.setLight(track.light, Light(
+            track.position.empty() ? current.position
+                                   : track.position.at(frame),
+            track.color.empty() ? current.color : track.color.at(frame)));
+    }
+
+    for (MeshTrack const &track : d_meshes)
+    {
+        if (track.mesh >= instances.size())
+            throw runtime_error("Animation: no mesh " + to_string(track.mesh)
+                                + " (meshes of a scene cache cannot be "
+                                  "animated)");
+        Placement placement = placements[track.mesh];
+        if (!track.translation.empty())
+            placement.translation = track.translation.at(frame);
+        if (!track.rotation.empty())
+            placement.rotation = track.rotation.at(frame);
+        if (!track.scale.empty())
+            placement.scale = track.scale.at(frame);
+        instances[track.mesh]->setToWorld(placement.transform());
+    }
+    return !d_meshes.empty();
+}
+
+// --- Private -----------------------------------------------------------------
+
+// root is not const: missing keys read as null, without keys
+void Animation::readKeys(json &root)
+{
+    for (json &key : root["Camera"])
+    {
+        Real frame = key["frame"];
+        if (key.count("eye"))
+            d_eye.add(frame, Vector(key["eye"]));
+        if (key.count("center"))
+            d_center.add(frame, Vector(key["center"]));
+        if (key.count("up"))
+            d_up.add(frame, Vector(key["up"]));
+        if (key.count("fov"))
+            d_fov.add(frame, key["fov"].get<Real>());
+    }
+
+    for (json &node : root["Lights"])
+    {
+        LightTrack track;
+        track.light = node["light"];
+        for (json &key : node["keys"])
+        {
+            Real frame = key["frame"];
+            if (key.count("position"))
+                track.position.add(frame, Vector(key["position"]));
+            if (key.count("color"))
+                track.color.add(frame, Color(key["color"]));
+        }
+        d_lights.push_back(track);
+    }
+
+    for (json &node : root["Meshes"])
+    {
+        MeshTrack track;
+        track.mesh = node["mesh"];
+        for (json &key : node["keys"])
+        {
+            Real frame = key["frame"];
+            Placement placement(key);
+            if (key.count("translation"))
+                track.translation.add(frame, placement.translation);
+            if (key.count("rotation"))
+                track.rotation.add(frame, placement.rotation);
+            if (key.count("scale"))
+                track.scale.add(frame, placement.scale);
+        }
+        d_meshes.push_back(track);
+    }
+}
+
+string frameName(string const &pattern, unsigned frame)
+{
+    size_t percent = pattern.find('%');
+    if (percent != string::npos)
+    {
+        size_t end = pattern.find('d', percent);
+        string spec = pattern.substr(percent + 1, end - percent - 1);
+        if (end != string::npos
+            && spec.find_first_not_of("0123456789") == string::npos)
+        {
+            bool zeros = !spec.empty() && spec[0] == '0';
+            unsigned width = spec.empty() ? 0 : stoul(spec);
+            string number = to_string(frame);
+            if (number.size() < width)
+                number.insert(0, width - number.size(), zeros ? '0' : ' ');
+            return pattern.substr(0, percent) + number
+                   + pattern.substr(end + 1);
+        }
+    }
+
+    size_t dot = pattern.find_last_of('.');
+    if (dot == string::npos || pattern.find('/', dot) != string::npos)
+        dot = pattern.size();
+    char number[16];
+    snprintf(number, sizeof number, "%04u", frame);
+    return pattern.substr(0, dot) + number + pattern.substr(dot);
+}
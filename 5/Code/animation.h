@@ -0,0 +1,133 @@
+#ifndef ANIMATION_H_
+#define ANIMATION_H_
+
+#include "scene.h"
+#include "transform.h"
+#include "triple.h"
+
+#include "json/json_fwd.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+class MeshInstance;
+
+// Values of one animated property at key frames, linearly interpolated in
+// between and constant before the first and after the last key.
+template <typename T>
+class Track
+{
+    std::vector<std::pair<Real, T>> d_keys;     // ordered by frame
+
+    public:
+        void add(Real frame, T const &value);
+        bool empty() const;
+        T at(Real frame) const;
+};
+
+// A sequence of frames rendered by one process (ray --animation). Either
+// "Scenes" lists a scene file per frame (meshes and textures stay loaded
+// between them), or "Scene" is read once and "Frames" frames move its
+// camera, lights and mesh instances along key frames:
+//
+//  "Camera": [{"frame": 0, "eye": [..], "center": [..], "up": [..],
+//              "fov": ..}, ...]
+//  "Lights": [{"light": 0, "keys": [{"frame": 0, "position": [..],
+//                                    "color": [..]}, ...]}, ...]
+//  "Meshes": [{"mesh": 0, "keys": [{"frame": 0, "translation": [..],
+//                                   "rotation": [..], "scale": ..}, ...]}]
+//
+// every key field is optional, a property without keys keeps its value in
+// the scene. "light" and "mesh" are indices in the scene's "Lights" and
+// "Meshes". "Output" names the frames (see frameName). File names are
+// relative to the animation file.
+class Animation
+{
+    struct LightTrack
+    {
+        unsigned light;
+        Track<Vector> position;
+        Track<Color> color;
+    };
+
+    struct MeshTrack
+    {
+        unsigned mesh;
+        Track<Vector> translation;
+        Track<Vector> rotation;
+        Track<Vector> scale;
+    };
+
+    std::vector<std::string> d_scenes;      // one, or one per frame
+    unsigned d_frames = 0;
+    std::string d_output;
+
+    Track<Vector> d_eye;
+    Track<Vector> d_center;
+    Track<Vector> d_up;
+    Track<Real> d_fov;
+    std::vector<LightTrack> d_lights;
+    std::vector<MeshTrack> d_meshes;
+
+    public:
+        explicit Animation(std::string const &filename);
+
+        unsigned frames() const;
+
+        // the pattern of the frame file names, empty if not given
+        std::string const &output() const;
+
+        // whether every frame is a scene file of its own
+        bool sceneList() const;
+        std::string const &sceneFile(unsigned frame) const;
+
+        // Moves the camera, lights and the given mesh instances (in
+        // "Meshes" order, with their placement in the scene) of the scene
+        // to the frame. Returns whether instances moved: the acceleration
+        // structure then needs a refit.
+        bool apply(unsigned frame, Scene &scene,
+                   std::vector<MeshInstance *> const &instances,
+                   std::vector<Placement> const &placements) const;
+
+    private:
+        void readKeys(nlohmann::json &root);
+};
+
+// The file name of a frame: the printf style %d (or %0Nd) in pattern
+// replaced by the frame number. Without one the frame number (4 digits)
+// is inserted before the extension.
+std::string frameName(std::string const &pattern, unsigned frame);
+
+template <typename T>
+void Track<T>::add(Real frame, T const &value)
+{
+    auto pos = d_keys.begin();
+    while (pos != d_keys.end() && pos->first < frame)
+        ++pos;
+    d_keys.insert(pos, std::make_pair(frame, value));
+}
+
+template <typename T>
+bool Track<T>::empty() const
+{
+    return d_keys.empty();
+}
+
+template <typename T>
+T Track<T>::at(Real frame) const
+{
+    if (frame <= d_keys.front().first)
+        return d_keys.front().second;
+    for (size_t idx = 1; idx != d_keys.size(); ++idx)
+        if (frame < d_keys[idx].first)
+        {
+            auto const &from = d_keys[idx - 1];
+            auto const &to = d_keys[idx];
+            Real weight = (frame - from.first) / (to.first - from.first);
+            return (1 - weight) * from.second + weight * to.second;
+        }
+    return d_keys.back().second;
+}
+
+#endif
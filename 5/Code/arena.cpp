@@ -0,0 +1,39 @@
+#include "arena.h"
+
+#include <algorithm>
+
+using namespace std;
+
+Arena::~Arena()
+{
+    clear();
+}
+
+void Arena::clear()
+{
+    for (auto pos = d_destructors.rbegin(); pos != d_destructors.rend(); ++pos)
+        pos->second(pos->first);
+    d_destructors.clear();
+    d_blocks.clear();
+}
+
+void *Arena::allocate(size_t size, size_t align)
+{
+    if (!d_blocks.empty())
+    {
+        Block &block = d_blocks.back();
+        size_t start = (block.used + align - 1) / align * align;
+        if (start + size <= block.size)
+        {
+            block.used = start + size;
+            return block.data.get() + start;
+        }
+    }
+
+    // new char[] is aligned for any fundamental type, larger objects get a
+    // block of their own
+    size_t blockSize = max(size_t(BLOCK_SIZE), size);
+    d_blocks.push_back(Block{unique_ptr<char[]>(new char[blockSize]),
+                             blockSize, size});
+    return d_blocks.back().data.get();
+}
@@ -0,0 +1,68 @@
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Monotonic arena: objects of any type are constructed one after the
+// other in large blocks, nothing is freed on its own. clear() and the
+// destructor destroy all objects (in reverse order) and release the
+// blocks. Objects created together end up next to each other in memory,
+// and pointers to them stay valid until the arena is cleared.
+class Arena
+{
+    enum { BLOCK_SIZE = 64 * 1024 };
+
+    struct Block
+    {
+        std::unique_ptr<char[]> data;
+        size_t size;
+        size_t used;
+    };
+
+    std::vector<Block> d_blocks;
+    std::vector<std::pair<void *, void (*)(void *)>> d_destructors;
+
+    public:
+        Arena() = default;
+        ~Arena();
+
+        Arena(Arena const &) = delete;
+        Arena &operator=(Arena const &) = delete;
+
+        template <typename T, typename... Args>
+        T *create(Args &&...args);
+
+        void clear();
+
+    private:
+        // size bytes aligned to align (at most that of max_align_t)
+        void *allocate(size_t size, size_t align);
+
+        template <typename T>
+        static void destroy(void *object);
+};
+
+template <typename T, typename... Args>
+T *Arena::create(Args &&...args)
+{
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "Arena: over-aligned type");
+    T *object = new (allocate(sizeof(T), alignof(T)))
+                    T(std::forward<Args>(args)...);
+    if (!std::is_trivially_destructible<T>::value)
+        d_destructors.emplace_back(object, &destroy<T>);
+    return object;
+}
+
+template <typename T>
+void Arena::destroy(void *object)
+{
+    static_cast<T *>(object)->~T();
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef BLOB_H_
+#define BLOB_H_
+
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+// Flat binary serialization for the scene cache (see scenecache.h):
+// values and arrays of trivially copyable types are written as their raw
+// bytes in native byte order. Arrays start at multiples of ALIGNMENT from
+// the start of the blob, so a memory mapped blob has them aligned.
+
+enum { BLOB_ALIGNMENT = 16 };
+
+class BlobWriter
+{
+    std::ostream &d_out;
+    size_t d_offset = 0;
+
+    public:
+        explicit BlobWriter(std::ostream &out)
+        :
+            d_out(out)
+        {}
+
+        template <typename T>
+        void write(T const &value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value,
+                          "only raw data can be written to a blob");
+            writeBytes(&value, sizeof(T));
+        }
+
+        // the element count followed by the (aligned) elements
+        template <typename T>
+        void writeArray(std::vector<T> const &values)
+        {
+            static_assert(std::is_trivially_copyable<T>::value,
+                          "only raw data can be written to a blob");
+            write<unsigned long long>(values.size());
+            pad();
+            writeBytes(values.data(), values.size() * sizeof(T));
+        }
+
+    private:
+        void writeBytes(void const *data, size_t size)
+        {
+            d_out.write(static_cast<char const *>(data), size);
+            d_offset += size;
+        }
+
+        void pad()
+        {
+            static char const zeros[BLOB_ALIGNMENT] = {};
+            writeBytes(zeros, (BLOB_ALIGNMENT - d_offset % BLOB_ALIGNMENT)
+                              % BLOB_ALIGNMENT);
+        }
+};
+
+// Reads what BlobWriter wrote from memory (e.g. a MappedFile), throwing
+// if the blob ends early
+class BlobReader
+{
+    char const *d_begin;
+    char const *d_pos;
+    char const *d_end;
+
+    public:
+        BlobReader(char const *begin, char const *end)
+        :
+            d_begin(begin),
+            d_pos(begin),
+            d_end(end)
+        {}
+
+        template <typename T>
+        T read()
+        {
+            static_assert(std::is_trivially_copyable<T>::value,
+                          "only raw data can be read from a blob");
+            T value;
+            read(value);
+            return value;
+        }
+
+        // into an existing object, for types without a default constructor
+        template <typename T>
+        void read(T &value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value,
+                          "only raw data can be read from a blob");
+            std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        }
+
+        template <typename T>
+        void readArray(std::vector<T> &values)
+        {
+            static_assert(std::is_trivially_copyable<T>::value,
+                          "only raw data can be read from a blob");
+            size_t count = read<unsigned long long>();
+            take((BLOB_ALIGNMENT - (d_pos - d_begin) % BLOB_ALIGNMENT)
+                 % BLOB_ALIGNMENT);
+            if (count > size_t(d_end - d_pos) / sizeof(T))
+                throw std::runtime_error("scene cache: truncated file");
+            values.resize(count);
+            std::memcpy(values.data(), take(count * sizeof(T)),
+                        count * sizeof(T));
+        }
+
+    private:
+        char const *take(size_t size)
+        {
+            if (size > size_t(d_end - d_pos))
+                throw std::runtime_error("scene cache: truncated file");
+            char const *data = d_pos;
+            d_pos += size;
+            return data;
+        }
+};
+
+#endif
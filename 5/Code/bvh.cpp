@@ -0,0 +1,213 @@
+#include "bvh.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace
+{
+    unsigned const NUM_BINS = 16;       // SAH candidate splits per axis
+    unsigned const MAX_LEAF_SIZE = 4;
+    double const TRAVERSAL_COST = 1.0;  // relative to one intersection test
+}
+
+void BVH::build(vector<AABB> const &boxes)
+{
+    d_nodes.clear();
+    d_prims.clear();
+    if (boxes.empty())
+        return;
+
+    vector<BuildPrim> prims;
+    prims.reserve(boxes.size());
+    for (unsigned idx = 0; idx != boxes.size(); ++idx)
+        prims.push_back(BuildPrim{boxes[idx], boxes[idx].centroid(), idx});
+
+    d_nodes.reserve(2 * prims.size());
+    d_prims.reserve(prims.size());
+    buildRecursive(prims, 0, prims.size(), 0);
+}
+
+// Children are stored after their parent, so visiting the nodes backwards
+// bounds every child before its parent
+void BVH::refit(vector<AABB> const &boxes)
+{
+    for (size_t idx = d_nodes.size(); idx-- != 0; )
+    {
+        Node &node = d_nodes[idx];
+        node.box = AABB();
+        if (node.count != 0)
+            for (unsigned prim = 0; prim != node.count; ++prim)
+                node.box.extend(boxes[d_prims[node.first + prim]]);
+        else
+        {
+            node.box.extend(d_nodes[idx + 1].box);
+            node.box.extend(d_nodes[node.right].box);
+        }
+    }
+}
+
+vector<unsigned> BVH::reorderPrimitives()
+{
+    vector<unsigned> order;
+    order.swap(d_prims);
+    d_prims.resize(order.size());
+    for (unsigned idx = 0; idx != d_prims.size(); ++idx)
+        d_prims[idx] = idx;
+    return order;
+}
+
+bool BVH::empty() const
+{
+    return d_nodes.empty();
+}
+
+AABB BVH::bounds() const
+{
+    return d_nodes.empty() ? AABB() : d_nodes[0].box;
+}
+
+vector<BVH::Node> const &BVH::nodes() const
+{
+    return d_nodes;
+}
+
+void BVH::write(BlobWriter &out) const
+{
+    out.writeArray(d_nodes);
+    out.writeArray(d_prims);
+}
+
+void BVH::read(BlobReader &in)
+{
+    in.readArray(d_nodes);
+    in.readArray(d_prims);
+}
+
+// --- Private -----------------------------------------------------------------
+
+unsigned BVH::buildRecursive(vector<BuildPrim> &prims,
+                             unsigned first, unsigned last, unsigned depth)
+{
+    unsigned nodeIdx = d_nodes.size();
+    d_nodes.push_back(Node{AABB(), 0, 0, 0});
+
+    AABB box;
+    AABB centroidBox;
+    for (unsigned idx = first; idx != last; ++idx)
+    {
+        box.extend(prims[idx].box);
+        centroidBox.extend(prims[idx].centroid);
+    }
+    d_nodes[nodeIdx].box = box;
+
+    unsigned count = last - first;
+    double leafCost = count;
+
+    // Find the cheapest binned SAH split over all three axes
+    unsigned bestAxis = 3;
+    unsigned bestBin = 0;
+    double bestCost = leafCost;
+    if (count > 1 && depth + 1 < MAX_DEPTH)
+    {
+        for (unsigned axis = 0; axis != 3; ++axis)
+        {
+            double lo = centroidBox.min.data[axis];
+            double extent = centroidBox.max.data[axis] - lo;
+            if (extent <= 0.0)
+                continue;       // all centroids on one plane
+
+            AABB binBox[NUM_BINS];
+            unsigned binCount[NUM_BINS] = {};
+            double scale = NUM_BINS / extent;
+            for (unsigned idx = first; idx != last; ++idx)
+            {
+                unsigned bin = min(NUM_BINS - 1, static_cast<unsigned>(
+                    (prims[idx].centroid.data[axis] - lo) * scale));
+                binBox[bin].extend(prims[idx].box);
+                ++binCount[bin];
+            }
+
+            // sweep from the right to get the area/count right of each split
+            double rightArea[NUM_BINS];
+            unsigned rightCount[NUM_BINS];
+            AABB acc;
+            unsigned accCount = 0;
+            for (unsigned bin = NUM_BINS - 1; bin != 0; --bin)
+            {
+                acc.extend(binBox[bin]);
+                accCount += binCount[bin];
+                rightArea[bin] = acc.area();
+                rightCount[bin] = accCount;
+            }
+
+            // sweep from the left and evaluate the SAH at every split
+            acc = AABB();
+            accCount = 0;
+            double invArea = 1.0 / box.area();
+            for (unsigned bin = 1; bin != NUM_BINS; ++bin)
+            {
+                acc.extend(binBox[bin - 1]);
+                accCount += binCount[bin - 1];
+                if (accCount == 0 || rightCount[bin] == 0)
+                    continue;
+
+                double cost = TRAVERSAL_COST + invArea *
+                    (acc.area() * accCount + rightArea[bin] * rightCount[bin]);
+                if (cost < bestCost)
+                {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = bin;
+                }
+            }
+        }
+    }
+
+    // Splitting does not pay off: make a leaf, unless it is too big to
+    // be one, then fall back to a median split on the widest axis.
+    unsigned mid;
+    if (bestAxis == 3)
+    {
+        if (count <= MAX_LEAF_SIZE || depth + 1 >= MAX_DEPTH)
+        {
+            d_nodes[nodeIdx].first = d_prims.size();
+            d_nodes[nodeIdx].count = count;
+            for (unsigned idx = first; idx != last; ++idx)
+                d_prims.push_back(prims[idx].index);
+            return nodeIdx;
+        }
+
+        Vector extent = centroidBox.max - centroidBox.min;
+        unsigned axis = 0;
+        if (extent.y > extent.x)
+            axis = 1;
+        if (extent.z > extent.data[axis])
+            axis = 2;
+        mid = first + count / 2;
+        nth_element(prims.begin() + first, prims.begin() + mid,
+                    prims.begin() + last,
+                    [axis](BuildPrim const &lhs, BuildPrim const &rhs)
+                    {
+                        return lhs.centroid.data[axis] < rhs.centroid.data[axis];
+                    });
+    }
+    else
+    {
+        double lo = centroidBox.min.data[bestAxis];
+        double scale = NUM_BINS / (centroidBox.max.data[bestAxis] - lo);
+        auto split = partition(prims.begin() + first, prims.begin() + last,
+                     [=](BuildPrim const &prim)
+                     {
+                         unsigned bin = min(NUM_BINS - 1, static_cast<unsigned>(
+                             (prim.centroid.data[bestAxis] - lo) * scale));
+                         return bin < bestBin;
+                     });
+        mid = split - prims.begin();
+    }
+
+    buildRecursive(prims, first, mid, depth + 1);
+    unsigned right = buildRecursive(prims, mid, last, depth + 1);
+    d_nodes[nodeIdx].right = right;
+    return nodeIdx;
+}
@@ -0,0 +1,218 @@
+#ifndef BVH_H_
+#define BVH_H_
+
+#include "aabb.h"
+#include "blob.h"
+#include "packet.h"
+#include "ray.h"
+#include "renderstats.h"
+
+#include <algorithm>
+#include <vector>
+
+// Bounding volume hierarchy over a set of primitives, built with the
+// surface area heuristic (SAH). The BVH only knows the bounding boxes of
+// the primitives, the caller supplies the primitive intersection as a
+// functor during traversal.
+class BVH
+{
+    public:
+        enum { MAX_DEPTH = 64 };    // bounds the traversal stack
+
+        // Nodes are stored depth first: the left child of an interior node
+        // directly follows it, the right child is at index 'right'.
+        struct Node
+        {
+            AABB box;
+            unsigned first;     // leaf: index of first primitive in d_prims
+            unsigned count;     // leaf: number of primitives, 0 if interior
+            unsigned right;     // interior: index of the right child
+        };
+
+    private:
+        std::vector<Node> d_nodes;
+        std::vector<unsigned> d_prims;  // primitive indices, leaf ordered
+
+    public:
+        // build the hierarchy over the given primitive boxes, the
+        // primitives are referred to by their index in boxes
+        void build(std::vector<AABB> const &boxes);
+
+        // Update the node bounds to moved primitives (boxes indexed as the
+        // traversal reports them), keeping the tree. Much cheaper than a
+        // build, but the tree degrades when primitives move far.
+        void refit(std::vector<AABB> const &boxes);
+
+        // For callers that store their primitives in leaf order (so leaves
+        // stream through memory): returns that order, after which the
+        // traversal reports positions in it instead of the build indices.
+        std::vector<unsigned> reorderPrimitives();
+
+        bool empty() const;
+        AABB bounds() const;
+        std::vector<Node> const &nodes() const;
+
+        // store / restore a built hierarchy (scene cache)
+        void write(BlobWriter &out) const;
+        void read(BlobReader &in);
+
+        // Visit all primitives whose leaves are hit by the ray before tMax,
+        // nearest node first. The functor is called as
+        //      bool intersect(unsigned prim, Real &tMax)
+        // and lowers tMax when it finds a closer hit. Returning true
+        // terminates the traversal (any hit queries).
+        template <typename Intersector>
+        void traverse(Ray const &ray, Real tMax, Intersector &&intersect) const;
+
+        // Packet version: visits the primitives of all leaves hit by any
+        // active lane, the functor is called as intersect(unsigned prim)
+        // and updates hit itself.
+        template <typename Intersector>
+        void traversePacket(RayPacket const &packet, PacketHit const &hit,
+                            PacketKernels const &kernels,
+                            Intersector &&intersect) const;
+
+    private:
+        struct BuildPrim
+        {
+            AABB box;
+            Point centroid;
+            unsigned index;
+        };
+
+        unsigned buildRecursive(std::vector<BuildPrim> &prims,
+                                unsigned first, unsigned last,
+                                unsigned depth);
+};
+
+template <typename Intersector>
+void BVH::traverse(Ray const &ray, Real tMax, Intersector &&intersect) const
+{
+    if (d_nodes.empty())
+        return;
+
+    Vector invD(1.0 / ray.D.x, 1.0 / ray.D.y, 1.0 / ray.D.z);
+    unsigned long long &boxTests = threadCounters().tests[RayCounters::BOX];
+
+    struct Entry
+    {
+        unsigned node;
+        Real tNear;
+    } stack[MAX_DEPTH];
+    unsigned top = 0;
+    unsigned node = 0;
+    Real tNear;
+    ++boxTests;
+    if (!d_nodes[0].box.intersect(ray, invD, tMax, tNear))
+        return;
+
+    while (true)
+    {
+        Node const &current = d_nodes[node];
+        if (current.count != 0)     // leaf
+        {
+            for (unsigned idx = 0; idx != current.count; ++idx)
+                if (intersect(d_prims[current.first + idx], tMax))
+                    return;
+        }
+        else
+        {
+            unsigned left = node + 1;
+            unsigned right = current.right;
+            Real tLeft, tRight;
+            boxTests += 2;
+            bool hitLeft = d_nodes[left].box.intersect(ray, invD, tMax, tLeft);
+            bool hitRight = d_nodes[right].box.intersect(ray, invD, tMax, tRight);
+
+            if (hitLeft && hitRight)
+            {
+                // descend into the nearest child, postpone the other
+                if (tRight < tLeft)
+                    std::swap(left, right);
+                stack[top++] = Entry{right, std::max(tLeft, tRight)};
+                node = left;
+                continue;
+            }
+            if (hitLeft)
+            {
+                node = left;
+                continue;
+            }
+            if (hitRight)
+            {
+                node = right;
+                continue;
+            }
+        }
+
+        // pop the next node that is still in front of the closest hit
+        do
+        {
+            if (top == 0)
+                return;
+            --top;
+        }
+        while (stack[top].tNear > tMax);
+        node = stack[top].node;
+    }
+}
+
+template <typename Intersector>
+void BVH::traversePacket(RayPacket const &packet, PacketHit const &hit,
+                         PacketKernels const &kernels,
+                         Intersector &&intersect) const
+{
+    if (d_nodes.empty())
+        return;
+
+    unsigned long long &boxTests = threadCounters().tests[RayCounters::BOX];
+    unsigned stack[MAX_DEPTH];
+    unsigned top = 0;
+    unsigned node = 0;
+    float tNear;
+    boxTests += kernels.width;      // counted per lane
+    if (!kernels.box(packet, hit, d_nodes[0].box.min.data,
+                     d_nodes[0].box.max.data, tNear))
+        return;
+
+    while (true)
+    {
+        Node const &current = d_nodes[node];
+        if (current.count != 0)     // leaf
+        {
+            for (unsigned idx = 0; idx != current.count; ++idx)
+                intersect(d_prims[current.first + idx]);
+        }
+        else
+        {
+            unsigned left = node + 1;
+            unsigned right = current.right;
+            float tLeft, tRight;
+            boxTests += 2 * kernels.width;
+            bool hitLeft = kernels.box(packet, hit, d_nodes[left].box.min.data,
+                                       d_nodes[left].box.max.data, tLeft);
+            bool hitRight = kernels.box(packet, hit, d_nodes[right].box.min.data,
+                                        d_nodes[right].box.max.data, tRight);
+
+            if (hitLeft && hitRight)
+            {
+                if (tRight < tLeft)
+                    std::swap(left, right);
+                stack[top++] = right;
+                node = left;
+                continue;
+            }
+            if (hitLeft || hitRight)
+            {
+                node = hitLeft ? left : right;
+                continue;
+            }
+        }
+
+        if (top == 0)
+            return;
+        node = stack[--top];
+    }
+}
+
+#endif
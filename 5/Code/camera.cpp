@@ -0,0 +1,74 @@
+#include "camera.h"
+
+#include "json/json.h"
+
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using json = nlohmann::json;
+
+Camera::Camera(Point const &eye, Point const &center, Vector const &up,
+               unsigned viewWidth, unsigned viewHeight, Real fov)
+:
+    eye(eye),
+    center(center),
+    up(up),
+    viewWidth(viewWidth),
+    viewHeight(viewHeight),
+    fov(fov),
+    d_axis(center - eye)
+{
+    setResolution(viewWidth, viewHeight);
+}
+
+Camera::Camera(json const &node)
+:
+    Camera(Point(node["eye"]), Point(node["center"]), Vector(node["up"]),
+           node["viewSize"][0], node["viewSize"][1],
+           node.count("fov") ? node["fov"].get<double>() : 0.0)
+{}
+
+Camera Camera::fromEye(Point const &eye)
+{
+    Camera camera(eye, Point(200, 200, 0), Vector(0, 1, 0), 400, 400);
+    camera.d_axis = Vector(0, 0, -1);
+    camera.setResolution(400, 400);
+    return camera;
+}
+
+void Camera::setResolution(unsigned width, unsigned height)
+{
+    if (width == 0 || height == 0 || viewWidth == 0 || viewHeight == 0)
+        throw runtime_error("Camera: resolution must be positive");
+
+    Vector right = d_axis.cross(up).normalized();
+    Vector vup = right.cross(d_axis).normalized();
+
+    // size of one pixel at this resolution
+    Real pixelSize;
+    if (fov > 0.0)
+    {
+        Real viewHeightWorld = 2.0 * (center - eye).length()
+                               * tan(fov * M_PI / 360.0);
+        pixelSize = viewHeightWorld / height;
+    }
+    else
+        pixelSize = up.length() * viewWidth / width;
+
+    d_right = right * pixelSize;
+    d_down = -vup * pixelSize;
+    d_origin = center - d_right * (width / 2.0) - d_down * (height / 2.0);
+}
+
+Real Camera::pixelSpread() const
+{
+    Real distance = fabs((center - eye).dot(d_axis.normalized()));
+    return d_right.length() / distance;
+}
+
+Ray Camera::ray(Real x, Real y) const
+{
+    Point pixel = d_origin + x * d_right + y * d_down;
+    return Ray(eye, (pixel - eye).normalized());
+}
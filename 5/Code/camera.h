@@ -0,0 +1,53 @@
+#ifndef CAMERA_H_
+#define CAMERA_H_
+
+#include "ray.h"
+#include "triple.h"
+
+#include "json/json_fwd.h"
+
+// Pinhole camera. The view plane is centered at 'center' and spanned by
+// 'up' and the right vector; at the scene's own resolution (viewSize) a
+// pixel is |up| world units wide. Rendering at another resolution keeps
+// the width of the view and scales the pixels accordingly. With a field
+// of view the view plane size follows from fov instead of |up|.
+class Camera
+{
+    public:
+        Point eye;
+        Point center;           // center of the view plane
+        Vector up;              // view up, length is the pixel size
+        unsigned viewWidth;     // the scene's own resolution
+        unsigned viewHeight;
+        Real fov;               // vertical field of view (degrees), 0: none
+
+    private:
+        Vector d_axis;          // the view plane is perpendicular to this
+        Point d_origin;         // corner of pixel (0, 0) on the view plane
+        Vector d_right;         // one pixel to the right
+        Vector d_down;          // one pixel down
+
+    public:
+        Camera(Point const &eye, Point const &center, Vector const &up,
+               unsigned viewWidth, unsigned viewHeight, Real fov = 0.0);
+
+        // "Camera": {"eye", "center", "up", "viewSize": [w, h], "fov"}
+        explicit Camera(nlohmann::json const &node);
+
+        // camera of scenes with only an "Eye": the view plane is z = 0,
+        // 400 x 400 pixels of 1 x 1 with the origin at the bottom left,
+        // whatever the position of the eye
+        static Camera fromEye(Point const &eye);
+
+        // set up the pixel grid for an image of width x height pixels
+        void setResolution(unsigned width, unsigned height);
+
+        // angle (radians) between the rays through neighbouring pixels
+        Real pixelSpread() const;
+
+        // ray through image position (x, y), in pixels from the top left
+        // corner: pixel (i, j) has its center at (i + 0.5, j + 0.5)
+        Ray ray(Real x, Real y) const;
+};
+
+#endif
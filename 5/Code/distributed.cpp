@@ -0,0 +1,683 @@
+#include "distributed.h"
+
+#include "image.h"
+#include "scene.h"
+#include "scenecache.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+namespace
+{
+    enum Message : uint32_t
+    {
+        SCENE,      // coordinator: SceneHeader, the scene cache
+        TILE,       // coordinator: TileJob
+        RESULT,     // worker: ResultHeader, the pixels of the tile
+        DONE        // coordinator: no more tiles, disconnect
+    };
+
+    struct MessageHeader
+    {
+        uint32_t type;
+        uint32_t padding;
+        uint64_t size;          // of the data that follows
+    };
+
+    struct SceneHeader
+    {
+        uint32_t width;         // of the whole image
+        uint32_t height;
+        uint32_t format;        // Image::Format
+    };
+
+    struct TileJob
+    {
+        uint32_t index;
+        Tile tile;
+    };
+
+    struct ResultHeader
+    {
+        uint32_t index;
+        uint32_t padding;
+        double seconds;         // to render the tile
+        RayCounters counters;
+    };
+
+    // tiles handed to a worker at a time: it renders one while the result
+    // of the other is on its way
+    unsigned const TILES_PER_WORKER = 2;
+
+    // a worker retries connecting once a second, the coordinator may not
+    // be up yet
+    unsigned const CONNECT_ATTEMPTS = 60;
+
+    template <typename T>
+    void append(vector<char> &data, T const &value)
+    {
+        char const *bytes = reinterpret_cast<char const *>(&value);
+        data.insert(data.end(), bytes, bytes + sizeof(T));
+    }
+
+    // the r, g, b components of all pixels of img
+    pair<char const *, size_t> pixelData(Image const &img)
+    {
+        if (img.format() == Image::FLOAT)
+            return make_pair(reinterpret_cast<char const *>(img.floatRow(0)),
+                             img.size() * 3 * sizeof(float));
+        return make_pair(reinterpret_cast<char const *>(img.byteRow(0)),
+                         img.size() * 3 * sizeof(uint8_t));
+    }
+
+    // false if the connection is gone
+    bool sendAll(int fd, char const *data, size_t size)
+    {
+        while (size > 0)
+        {
+            // no SIGPIPE if the other side is gone
+            ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent <= 0)
+                return false;
+            data += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    bool receiveAll(int fd, char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t received = recv(fd, data, size, 0);
+            if (received < 0 && errno == EINTR)
+                continue;
+            if (received <= 0)
+                return false;
+            data += received;
+            size -= received;
+        }
+        return true;
+    }
+
+    bool sendMessage(int fd, Message type, vector<char> const &data)
+    {
+        MessageHeader header{type, 0, data.size()};
+        return sendAll(fd, reinterpret_cast<char const *>(&header),
+                       sizeof header)
+               && sendAll(fd, data.data(), data.size());
+    }
+
+    // blocks until a whole message is in, false if the connection is gone
+    bool receiveMessage(int fd, Message &type, vector<char> &data)
+    {
+        MessageHeader header;
+        if (!receiveAll(fd, reinterpret_cast<char *>(&header), sizeof header))
+            return false;
+        type = Message(header.type);
+        data.resize(header.size);
+        return receiveAll(fd, data.data(), data.size());
+    }
+
+    vector<char> message(Message type, vector<char> const &data)
+    {
+        MessageHeader header{type, 0, data.size()};
+        vector<char> bytes(sizeof header + data.size());
+        memcpy(bytes.data(), &header, sizeof header);
+        copy(data.begin(), data.end(), bytes.begin() + sizeof header);
+        return bytes;
+    }
+
+    // small messages (tiles) go out at once
+    void setNoDelay(int fd)
+    {
+        int yes = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof yes);
+    }
+
+    // a new file in $TMPDIR (or /tmp), the caller removes it
+    string temporaryFile()
+    {
+        char const *dir = getenv("TMPDIR");
+        string name = string(dir && *dir ? dir : "/tmp") + "/ray-scene-XXXXXX";
+        int fd = mkstemp(&name[0]);
+        if (fd < 0)
+            throw runtime_error("Could not create a temporary file " + name);
+        close(fd);
+        return name;
+    }
+
+    vector<char> readFile(string const &filename)
+    {
+        ifstream in(filename, ios::binary);
+        return vector<char>(istreambuf_iterator<char>(in),
+                            istreambuf_iterator<char>());
+    }
+
+    int listenOn(unsigned port, unsigned &bound)
+    {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        int yes = 1;
+        sockaddr_in address = sockaddr_in();
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+        socklen_t length = sizeof address;
+        if (fd < 0
+            || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof yes) != 0
+            || bind(fd, reinterpret_cast<sockaddr *>(&address), length) != 0
+            || listen(fd, SOMAXCONN) != 0
+            || getsockname(fd, reinterpret_cast<sockaddr *>(&address),
+                           &length) != 0)
+        {
+            string error = strerror(errno);
+            if (fd >= 0)
+                close(fd);
+            throw runtime_error("Could not listen on port " + to_string(port)
+                                + ": " + error);
+        }
+        bound = ntohs(address.sin_port);
+        return fd;
+    }
+
+    // host:port, -1 if nothing accepts the connection
+    int connectTo(string const &address)
+    {
+        size_t colon = address.find_last_of(':');
+        if (colon == string::npos)
+            throw runtime_error("Coordinator address " + address
+                                + " is not host:port");
+        string host = address.substr(0, colon);
+        string port = address.substr(colon + 1);
+
+        addrinfo hints = addrinfo();
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *found;
+        int error = getaddrinfo(host.c_str(), port.c_str(), &hints, &found);
+        if (error != 0)
+            throw runtime_error("Coordinator " + address + ": "
+                                + gai_strerror(error));
+
+        int fd = -1;
+        for (addrinfo *entry = found; entry && fd < 0; entry = entry->ai_next)
+        {
+            fd = socket(entry->ai_family, entry->ai_socktype,
+                        entry->ai_protocol);
+            if (fd >= 0 && connect(fd, entry->ai_addr, entry->ai_addrlen) != 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(found);
+        return fd;
+    }
+
+    // starts this program as a worker, its output would interleave with
+    // the coordinator's and goes to /dev/null
+    pid_t spawnWorker(vector<string> const &args)
+    {
+        vector<char *> argv;
+        for (string const &arg : args)
+            argv.push_back(const_cast<char *>(arg.c_str()));
+        argv.push_back(nullptr);
+
+        // only async signal safe calls between fork and exec
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            int null = open("/dev/null", O_WRONLY);
+            if (null >= 0)
+                dup2(null, STDOUT_FILENO);
+            execv("/proc/self/exe", argv.data());
+            _exit(127);
+        }
+        return pid;
+    }
+
+    class Coordinator
+    {
+        typedef chrono::steady_clock Clock;
+
+        // The sockets of the workers do not block: what cannot be sent
+        // yet waits in the worker's queue, so one worker that stops
+        // reading holds up nobody else and times out like a silent one.
+        struct Worker
+        {
+            int fd;
+            unsigned id;
+            vector<char> buffer;        // received, not handled yet
+            size_t sceneSent;           // bytes of the SCENE message sent
+            vector<char> outgoing;      // messages after the scene, unsent
+            vector<unsigned> tiles;     // handed out, not returned yet
+            Clock::time_point heard;    // last data either way, or work
+                                        // after idling
+
+            bool sending(size_t sceneSize) const
+            {
+                return sceneSent != sceneSize || !outgoing.empty();
+            }
+        };
+
+        Image &d_img;
+        DistributedOptions const &d_options;
+        RayCounters &d_counters;
+        vector<TileStats> &d_stats;
+
+        vector<char> d_scene;           // the SCENE message
+        vector<Tile> d_tiles;
+        deque<unsigned> d_pending;      // tiles to hand out
+        vector<bool> d_done;
+        unsigned d_remaining;
+
+        int d_listener;
+        vector<Worker> d_workers;
+        unsigned d_connected = 0;
+        vector<pid_t> d_children;      // spawned, still running
+
+        public:
+            Coordinator(Scene const &scene, Image &img,
+                        DistributedOptions const &options,
+                        RayCounters &counters, vector<TileStats> &stats);
+            ~Coordinator();
+
+            void run();
+
+        private:
+            void accept();
+            bool receive(Worker &worker);
+            bool handle(Worker &worker, Message type, char const *data,
+                        size_t size);
+            void assign(Worker &worker);
+            bool flush(Worker &worker);
+            void fail(size_t idx, string const &reason);
+            bool childrenExited();
+    };
+
+    Coordinator::Coordinator(Scene const &scene, Image &img,
+                             DistributedOptions const &options,
+                             RayCounters &counters, vector<TileStats> &stats)
+    :
+        d_img(img),
+        d_options(options),
+        d_counters(counters),
+        d_stats(stats)
+    {
+        // the scene goes out as a scene cache
+        string cacheFile = temporaryFile();
+        try
+        {
+            writeSceneCache(cacheFile, scene);
+        }
+        catch (...)
+        {
+            unlink(cacheFile.c_str());
+            throw;
+        }
+        vector<char> data;
+        append(data, SceneHeader{img.width(), img.height(),
+                                 uint32_t(img.format())});
+        vector<char> cache = readFile(cacheFile);
+        unlink(cacheFile.c_str());
+        data.insert(data.end(), cache.begin(), cache.end());
+        d_scene = message(SCENE, data);
+
+        d_tiles = makeTiles(img.width(), img.height(),
+                            max(options.tileSize, 1U), TileOrder::SCANLINE);
+        for (unsigned idx = 0; idx != d_tiles.size(); ++idx)
+            d_pending.push_back(idx);
+        d_done.assign(d_tiles.size(), false);
+        d_remaining = d_tiles.size();
+
+        unsigned port;
+        d_listener = listenOn(options.port, port);
+        cout << "Coordinator listening on port " << port << ", "
+             << d_tiles.size() << " tiles.\n";
+
+        vector<string> args{"ray"};
+        args.insert(args.end(), options.workerArgs.begin(),
+                    options.workerArgs.end());
+        args.push_back("--worker");
+        args.push_back("127.0.0.1:" + to_string(port));
+        for (unsigned idx = 0; idx != options.spawn; ++idx)
+        {
+            pid_t pid = spawnWorker(args);
+            if (pid > 0)
+                d_children.push_back(pid);
+        }
+    }
+
+    Coordinator::~Coordinator()
+    {
+        for (Worker &worker : d_workers)
+        {
+            // not in the middle of another message
+            if (!worker.sending(d_scene.size()))
+                sendMessage(worker.fd, DONE, vector<char>());
+            close(worker.fd);
+        }
+        close(d_listener);
+        for (pid_t pid : d_children)
+            waitpid(pid, nullptr, 0);
+    }
+
+    void Coordinator::run()
+    {
+        bool waiting = false;
+        while (d_remaining > 0)
+        {
+            if (d_workers.empty() && !waiting)
+                cout << "Waiting for workers...\n";
+            waiting = d_workers.empty();
+            if (waiting && !d_children.empty() && childrenExited())
+                throw runtime_error("All spawned workers exited");
+
+            vector<pollfd> fds(1, pollfd{d_listener, POLLIN, 0});
+            for (Worker const &worker : d_workers)
+            {
+                short events = worker.sending(d_scene.size())
+                               ? POLLIN | POLLOUT : POLLIN;
+                fds.push_back(pollfd{worker.fd, events, 0});
+            }
+            if (poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR)
+                throw runtime_error(string("poll: ") + strerror(errno));
+
+            // backwards: failing removes the worker
+            for (size_t idx = d_workers.size(); idx-- != 0; )
+            {
+                short revents = fds[idx + 1].revents;
+                if (((revents & POLLOUT) && !flush(d_workers[idx]))
+                    || ((revents & ~POLLOUT) && !receive(d_workers[idx])))
+                    fail(idx, "disconnected");
+            }
+            if (fds[0].revents & POLLIN)
+                accept();
+
+            Clock::time_point now = Clock::now();
+            for (size_t idx = d_workers.size(); idx-- != 0; )
+            {
+                chrono::duration<double> silent = now - d_workers[idx].heard;
+                bool busy = !d_workers[idx].tiles.empty()
+                            || d_workers[idx].sending(d_scene.size());
+                if (d_options.timeout > 0 && busy
+                    && silent.count() > d_options.timeout)
+                    fail(idx, "timed out");
+            }
+            for (Worker &worker : d_workers)
+                assign(worker);
+            for (size_t idx = d_workers.size(); idx-- != 0; )
+                if (!flush(d_workers[idx]))
+                    fail(idx, "disconnected");
+        }
+    }
+
+    void Coordinator::accept()
+    {
+        int fd = ::accept(d_listener, nullptr, nullptr);
+        if (fd < 0)
+            return;
+        setNoDelay(fd);
+        if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0)
+        {
+            close(fd);
+            return;
+        }
+        // the scene and the first tiles go out from run
+        d_workers.push_back(Worker{fd, d_connected++, vector<char>(), 0,
+                                   vector<char>(), vector<unsigned>(),
+                                   Clock::now()});
+        cout << "Worker " << d_workers.back().id << " connected.\n";
+    }
+
+    // reads what arrived and handles the messages that are complete
+    bool Coordinator::receive(Worker &worker)
+    {
+        char chunk[1 << 16];
+        ssize_t received = recv(worker.fd, chunk, sizeof chunk, 0);
+        if (received < 0
+            && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK))
+            return true;
+        if (received <= 0)
+            return false;
+        worker.buffer.insert(worker.buffer.end(), chunk, chunk + received);
+        worker.heard = Clock::now();
+
+        size_t used = 0;
+        MessageHeader header;
+        while (worker.buffer.size() - used >= sizeof header)
+        {
+            memcpy(&header, worker.buffer.data() + used, sizeof header);
+            if (worker.buffer.size() - used - sizeof header < header.size)
+                break;
+            if (!handle(worker, Message(header.type),
+                        worker.buffer.data() + used + sizeof header,
+                        header.size))
+                return false;
+            used += sizeof header + header.size;
+        }
+        worker.buffer.erase(worker.buffer.begin(),
+                            worker.buffer.begin() + used);
+        return true;
+    }
+
+    // copies a tile into the image, false if the message is invalid
+    bool Coordinator::handle(Worker &worker, Message type, char const *data,
+                             size_t size)
+    {
+        ResultHeader result;
+        if (type != RESULT || size < sizeof result)
+            return false;
+        memcpy(&result, data, sizeof result);
+        auto pos = find(worker.tiles.begin(), worker.tiles.end(),
+                        result.index);
+        if (pos == worker.tiles.end())
+            return false;
+        worker.tiles.erase(pos);
+
+        Tile const &tile = d_tiles[result.index];
+        unsigned width = tile.x1 - tile.x0;
+        size_t pixelSize = d_img.format() == Image::FLOAT
+                           ? 3 * sizeof(float) : 3 * sizeof(uint8_t);
+        size_t rowSize = width * pixelSize;
+        if (size - sizeof result != (tile.y1 - tile.y0) * rowSize)
+            return false;
+        if (d_done[result.index])
+            return true;
+
+        char const *pixels = data + sizeof result;
+        for (unsigned y = tile.y0; y != tile.y1; ++y, pixels += rowSize)
+        {
+            char *row = d_img.format() == Image::FLOAT
+                ? reinterpret_cast<char *>(d_img.floatRow(y))
+                : reinterpret_cast<char *>(d_img.byteRow(y));
+            memcpy(row + tile.x0 * pixelSize, pixels, rowSize);
+        }
+        d_done[result.index] = true;
+        --d_remaining;
+        d_counters += result.counters;
+        d_stats.push_back(TileStats{tile, worker.id, result.seconds});
+        return true;
+    }
+
+    void Coordinator::assign(Worker &worker)
+    {
+        while (worker.tiles.size() < TILES_PER_WORKER && !d_pending.empty())
+        {
+            unsigned index = d_pending.front();
+            d_pending.pop_front();
+            if (d_done[index])
+                continue;
+
+            vector<char> data;
+            append(data, TileJob{index, d_tiles[index]});
+            // silence counts from the first tile after idling
+            if (worker.tiles.empty())
+                worker.heard = Clock::now();
+            worker.tiles.push_back(index);
+            vector<char> bytes = message(TILE, data);
+            worker.outgoing.insert(worker.outgoing.end(), bytes.begin(),
+                                   bytes.end());
+        }
+    }
+
+    // sends what the socket takes of the scene and the queued messages,
+    // false if the connection is gone
+    bool Coordinator::flush(Worker &worker)
+    {
+        while (worker.sending(d_scene.size()))
+        {
+            bool scene = worker.sceneSent != d_scene.size();
+            char const *data = scene ? d_scene.data() + worker.sceneSent
+                                     : worker.outgoing.data();
+            size_t size = scene ? d_scene.size() - worker.sceneSent
+                                : worker.outgoing.size();
+            // no SIGPIPE if the worker is gone
+            ssize_t sent = send(worker.fd, data, size, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return true;    // full, POLLOUT tells when to go on
+            if (sent <= 0)
+                return false;
+
+            worker.heard = Clock::now();
+            if (scene)
+                worker.sceneSent += sent;
+            else
+                worker.outgoing.erase(worker.outgoing.begin(),
+                                      worker.outgoing.begin() + sent);
+        }
+        return true;
+    }
+
+    // the tiles of the worker go first to the others
+    void Coordinator::fail(size_t idx, string const &reason)
+    {
+        Worker &worker = d_workers[idx];
+        cout << "Worker " << worker.id << ' ' << reason << ", reissuing "
+             << worker.tiles.size() << " tiles.\n";
+        for (unsigned index : worker.tiles)
+            d_pending.push_front(index);
+        close(worker.fd);
+        d_workers.erase(d_workers.begin() + idx);
+    }
+
+    // reaps the spawned workers that exited, true if none is left
+    bool Coordinator::childrenExited()
+    {
+        for (size_t idx = d_children.size(); idx-- != 0; )
+            if (waitpid(d_children[idx], nullptr, WNOHANG) != 0)
+                d_children.erase(d_children.begin() + idx);
+        return d_children.empty();
+    }
+}
+
+void renderDistributed(Scene const &scene, Image &img,
+                       DistributedOptions const &options,
+                       RayCounters &counters, vector<TileStats> &stats)
+{
+    Coordinator coordinator(scene, img, options, counters, stats);
+    coordinator.run();
+}
+
+unsigned renderAsWorker(string const &address, Scene &scene)
+{
+    int fd = -1;
+    for (unsigned attempt = 0; attempt != CONNECT_ATTEMPTS && fd < 0;
+         ++attempt)
+    {
+        if (attempt != 0)
+            this_thread::sleep_for(chrono::seconds(1));
+        fd = connectTo(address);
+    }
+    if (fd < 0)
+        throw runtime_error("Could not connect to the coordinator at "
+                            + address);
+    setNoDelay(fd);
+
+    Message type;
+    vector<char> data;
+    SceneHeader header;
+    if (!receiveMessage(fd, type, data) || type != SCENE
+        || data.size() < sizeof header)
+    {
+        close(fd);
+        throw runtime_error("No scene from the coordinator at " + address);
+    }
+    memcpy(&header, data.data(), sizeof header);
+
+    // the scene cache is read from a file
+    string cacheFile = temporaryFile();
+    {
+        ofstream out(cacheFile, ios::binary);
+        out.write(data.data() + sizeof header, data.size() - sizeof header);
+    }
+    try
+    {
+        readSceneCache(cacheFile, scene);
+    }
+    catch (...)
+    {
+        unlink(cacheFile.c_str());
+        close(fd);
+        throw;
+    }
+    unlink(cacheFile.c_str());
+    scene.buildAccelerationStructure();
+    cout << "Loaded " << scene.getNumObject() << " objects from the "
+         << "coordinator.\n";
+
+    unsigned rendered = 0;
+    Image img;
+    TileJob job;
+    while (receiveMessage(fd, type, data) && type == TILE
+           && data.size() == sizeof job)
+    {
+        memcpy(&job, data.data(), sizeof job);
+        unsigned width = job.tile.x1 - job.tile.x0;
+        unsigned height = job.tile.y1 - job.tile.y0;
+        if (img.width() != width || img.height() != height)
+            img = Image(width, height, Image::Format(header.format));
+
+        auto start = chrono::steady_clock::now();
+        scene.render(img, header.width, header.height, job.tile);
+        chrono::duration<double> elapsed = chrono::steady_clock::now()
+                                           - start;
+
+        vector<char> result;
+        append(result, ResultHeader{job.index, 0, elapsed.count(),
+                                    scene.rayCounters()});
+        pair<char const *, size_t> pixels = pixelData(img);
+        result.insert(result.end(), pixels.first,
+                      pixels.first + pixels.second);
+        if (!sendMessage(fd, RESULT, result))
+            break;
+        ++rendered;
+    }
+    close(fd);
+    return rendered;
+}
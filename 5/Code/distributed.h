@@ -0,0 +1,52 @@
+#ifndef DISTRIBUTED_H_
+#define DISTRIBUTED_H_
+
+#include "renderstats.h"
+#include "tiles.h"
+
+#include <string>
+#include <vector>
+
+class Image;
+class Scene;
+
+// Rendering one image with worker processes, on this machine or others
+// (ray --coordinator, ray --worker). The coordinator listens on a TCP
+// port and sends the scene, as a scene cache, to every worker that
+// connects. It then hands out tiles of the image, a few per worker at a
+// time; a worker renders a tile on all its threads and sends back its
+// pixels, which the coordinator copies into the image. The tiles of a
+// worker that disconnects (or for the timeout neither sends nor reads
+// anything) go back to the others. Workers may connect at any time, also
+// to replace failed ones.
+//
+// Messages are a type and a size followed by the data, in the byte order
+// of the machine: like the scene cache, the coordinator and its workers
+// must be the same build.
+
+struct DistributedOptions
+{
+    unsigned port = 0;          // to listen on, 0: any free port
+    unsigned spawn = 0;         // worker processes to start on this machine
+    unsigned tileSize = 256;    // of the tiles handed out
+    double timeout = 0;         // seconds a worker may stall, 0: no limit
+    std::vector<std::string> workerArgs;    // options of spawned workers
+};
+
+// Coordinator: renders scene to img (at its size and format) with the
+// workers, adding their rays to counters and the render time of every
+// tile (by worker, numbered in the order they connect) to stats. Returns
+// when every tile is in. Throws std::runtime_error if it cannot listen
+// or all spawned workers exit while none is connected.
+void renderDistributed(Scene const &scene, Image &img,
+                       DistributedOptions const &options,
+                       RayCounters &counters, std::vector<TileStats> &stats);
+
+// Worker: connects to the coordinator at address (host:port), retrying
+// for a while, loads the scene it sends into scene (which should be
+// empty) and renders tiles until the coordinator is done. Returns the
+// number of tiles rendered, throws std::runtime_error if it cannot
+// connect or receives no scene.
+unsigned renderAsWorker(std::string const &address, Scene &scene);
+
+#endif
@@ -7,21 +7,25 @@
 class Hit
 {
     public:
-        double t;   // distance of hit
+        Real t;     // distance of hit
         Vector N;   // Normal at hit
+        Real eps;   // machine epsilon of the arithmetic t was found in
+                    // (float for the packet kernels), bounds its error
 
-        Hit(double time, Vector const &normal)
+        Hit(Real time, Vector const &normal,
+            Real epsilon = std::numeric_limits<Real>::epsilon())
         :
             t(time),
-            N(normal)
+            N(normal),
+            eps(epsilon)
         {}
 
         static Hit const NO_HIT()
         {
-            static Hit no_hit(std::numeric_limits<double>::quiet_NaN(),
-                              Vector(std::numeric_limits<double>::quiet_NaN(),
-                                     std::numeric_limits<double>::quiet_NaN(),
-                                     std::numeric_limits<double>::quiet_NaN()));
+            static Hit no_hit(std::numeric_limits<Real>::quiet_NaN(),
+                              Vector(std::numeric_limits<Real>::quiet_NaN(),
+                                     std::numeric_limits<Real>::quiet_NaN(),
+                                     std::numeric_limits<Real>::quiet_NaN()));
             return no_hit;
         }
 };
@@ -1,43 +1,54 @@
 #include "image.h"
 
 #include "lode/lodepng.h"
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <fstream>
+#include <stdexcept>
 
 using namespace std;
 
-Image::Image(unsigned width, unsigned height)
+Image::Image(unsigned width, unsigned height, Format format)
 :
-    d_pixels(width * height),
+    d_format(format),
     d_width(width),
     d_height(height)
-{}
+{
+    if (format == FLOAT)
+        d_floats.resize(3 * size_t(width) * height);
+    else
+        d_bytes.resize(3 * size_t(width) * height);
+}
 
 Image::Image(string const &filename)
 {
     read_png(filename);
 }
 
-// normal accessors
-void Image::put_pixel(unsigned x, unsigned y, Color const &c)
+float *Image::floatRow(unsigned y)
 {
-    (*this)(x, y) = c;
+    return &d_floats[index(0, y)];
 }
-Color Image::get_pixel(unsigned x, unsigned y) const
+
+float const *Image::floatRow(unsigned y) const
 {
-    return (*this)(x, y);
+    return &d_floats[index(0, y)];
 }
 
-// Handier accessors
-// Usage: color = img(x,y);
-//        img(x,y) = color;
-Color const&Image::operator()(unsigned x, unsigned y) const
+uint8_t *Image::byteRow(unsigned y)
 {
-    return d_pixels.at(index(x, y));
+    return &d_bytes[index(0, y)];
 }
-Color &Image::operator()(unsigned x, unsigned y)
+
+uint8_t const *Image::byteRow(unsigned y) const
 {
-    return d_pixels.at(index(x, y));
+    return &d_bytes[index(0, y)];
+}
+
+Image::Format Image::format() const
+{
+    return d_format;
 }
 
 unsigned Image::width() const
@@ -57,43 +68,123 @@ unsigned Image::size() const
 
 // Normalized accessors, unsignederval is (0...1, 0...1)
 // usefull for texture access
-Color const &Image::colorAt(float x, float y) const
+Color Image::colorAt(float x, float y) const
 {
-    return d_pixels.at(findex(x, y));
+    return get_pixel(static_cast<unsigned>(x * (d_width - 1)),
+                     static_cast<unsigned>(y * (d_height - 1)));
 }
 
-void Image::write_png(std::string const &filename) const
+// Rows are quantized in parallel, the loop over a row is branch free so
+// the compiler vectorizes it
+void Image::quantize(vector<uint8_t> &rgb) const
 {
-    vector<unsigned char> image;
-    image.reserve(size() * 4);  // reserves size (less allocations)
-    for (Color pixel : d_pixels)
+    if (d_format == BYTE)
+    {
+        rgb = d_bytes;
+        return;
+    }
+
+    rgb.resize(d_floats.size());
+    int const rowSize = 3 * d_width;
+#pragma omp parallel for
+    for (int y = 0; y < static_cast<int>(d_height); ++y)
     {
-        image.push_back(static_cast<unsigned char>(pixel.r * 255.0));
-        image.push_back(static_cast<unsigned char>(pixel.g * 255.0));
-        image.push_back(static_cast<unsigned char>(pixel.b * 255.0));
-        image.push_back(255);   // alpha is always 1
+        float const *in = floatRow(y);
+        uint8_t *out = &rgb[size_t(y) * rowSize];
+#pragma omp simd
+        for (int idx = 0; idx < rowSize; ++idx)
+        {
+            float value = min(max(in[idx], 0.0f), 1.0f);
+            out[idx] = static_cast<uint8_t>(value * 255.0f);
+        }
     }
+}
 
-    lodepng::encode(filename, image, d_width, d_height);
+namespace
+{
+    string extension(string const &filename)
+    {
+        size_t dot = filename.find_last_of('.');
+        if (dot == string::npos || filename.find('/', dot) != string::npos)
+            return "";
+        string ext = filename.substr(dot + 1);
+        transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        return ext;
+    }
 }
 
-void Image::read_png(std::string const &filename)
+void Image::write(string const &filename, int compression) const
 {
-    vector<unsigned char> image;
-    lodepng::decode(image, d_width, d_height, filename);
-    d_pixels.reserve(size());
+    string ext = extension(filename);
+    if (ext == "ppm")
+        write_ppm(filename);
+    else if (ext == "pfm")
+        write_pfm(filename);
+    else
+        write_png(filename, compression);
+}
 
-    auto imgIter = image.begin();
-    while (imgIter != image.end())
+bool Image::isFloatFile(string const &filename)
+{
+    return extension(filename) == "pfm";
+}
+
+void Image::write_png(std::string const &filename, int compression) const
+{
+    if (d_format == BYTE)   // encoded as stored
     {
-        double r = (*imgIter) / 255.0;
-        ++imgIter;
-        double g = (*imgIter) / 255.0;
-        ++imgIter;
-        double b = (*imgIter) / 255.0;
-        ++imgIter;
-        // Ignore Alpha
-        ++imgIter;
-        d_pixels.push_back(Color(r, g, b));
+        writePNG(filename, d_bytes, d_width, d_height, compression);
+        return;
     }
+
+    vector<uint8_t> image;
+    quantize(image);
+    writePNG(filename, image, d_width, d_height, compression);
+}
+
+void Image::write_ppm(std::string const &filename) const
+{
+    vector<uint8_t> image;
+    quantize(image);
+
+    ofstream out(filename, ios::binary);
+    if (!out)
+        throw runtime_error("Could not open " + filename + " for writing.");
+    out << "P6\n" << d_width << ' ' << d_height << "\n255\n";
+    out.write(reinterpret_cast<char const *>(image.data()), image.size());
+    if (!out)
+        throw runtime_error("Writing " + filename + " failed.");
+}
+
+// PFM stores the rows bottom up, the negative scale marks little endian
+// floats (as on the machines this runs on)
+void Image::write_pfm(std::string const &filename) const
+{
+    ofstream out(filename, ios::binary);
+    if (!out)
+        throw runtime_error("Could not open " + filename + " for writing.");
+    out << "PF\n" << d_width << ' ' << d_height << "\n-1.0\n";
+
+    vector<float> row(3 * d_width);
+    for (unsigned y = d_height; y-- != 0; )
+    {
+        if (d_format == FLOAT)
+            copy(floatRow(y), floatRow(y) + row.size(), row.begin());
+        else
+            for (size_t idx = 0; idx != row.size(); ++idx)
+                row[idx] = byteRow(y)[idx] / 255.0f;
+        out.write(reinterpret_cast<char const *>(row.data()),
+                  row.size() * sizeof(float));
+    }
+    if (!out)
+        throw runtime_error("Writing " + filename + " failed.");
+}
+
+void Image::read_png(std::string const &filename)
+{
+    d_format = BYTE;
+    d_floats.clear();
+    d_bytes.clear();
+    d_width = d_height = 0;
+    lodepng::decode(d_bytes, d_width, d_height, filename, LCT_RGB);
 }
@@ -1,55 +1,126 @@
 #ifndef IMAGE_H_
 #define IMAGE_H_
 
+#include "pngwriter.h"
 #include "triple.h"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
+// RGB image stored row by row. Pixels are three floats (FLOAT, to
+// accumulate or post process) or three bytes (BYTE, for images that are
+// only written out: values are clamped to 0 ... 1 and quantized when they
+// are put), instead of the 24 bytes of a double Color. Pixel access is
+// unchecked.
 class Image
 {
-    std::vector<Color> d_pixels;
-    unsigned d_width;
-    unsigned d_height;
+    public:
+        enum Format
+        {
+            FLOAT,
+            BYTE
+        };
+
+    private:
+        Format d_format;
+        unsigned d_width;
+        unsigned d_height;
+        std::vector<float> d_floats;        // FLOAT: r, g, b per pixel
+        std::vector<uint8_t> d_bytes;       // BYTE: r, g, b per pixel
 
     public:
-        Image(unsigned width = 0, unsigned height = 0);
-        Image(std::string const &filename);
+        Image(unsigned width = 0, unsigned height = 0, Format format = FLOAT);
+        Image(std::string const &filename);     // a PNG file, as BYTE
 
         // normal accessors
         void put_pixel(unsigned x, unsigned y, Color const &c);
         Color get_pixel(unsigned x, unsigned y) const;
 
-        // Handier accessors
         // Usage: color = img(x,y);
-        //        img(x,y) = color;
-        Color const &operator()(unsigned x, unsigned y) const;
-        Color &operator()(unsigned x, unsigned y);
+        Color operator()(unsigned x, unsigned y) const;
 
+        // the r, g, b components of row y (FLOAT or BYTE images only)
+        float *floatRow(unsigned y);
+        float const *floatRow(unsigned y) const;
+        uint8_t *byteRow(unsigned y);
+        uint8_t const *byteRow(unsigned y) const;
+
+        Format format() const;
         unsigned width() const;
         unsigned height() const;
         unsigned size() const;
 
         // Normalized accessors, unsignederval is (0...1, 0...1)
         // usefull for texture access
-        Color const &colorAt(float x, float y) const;
+        Color colorAt(float x, float y) const;
+
+        // 8 bit r, g, b of all pixels, row by row (FLOAT images are
+        // clamped and quantized by all threads)
+        void quantize(std::vector<uint8_t> &rgb) const;
+
+        // Writes the image in the format of the file name's extension:
+        // .ppm (8 bit binary PPM), .pfm (float PFM, not clamped) or else
+        // PNG, compressed at the given zlib level (see pngwriter.h).
+        // Throws std::runtime_error if the file cannot be written.
+        void write(std::string const &filename,
+                   int compression = PNG_DEFAULT_COMPRESSION) const;
+
+        // whether write stores filename as floats (store FLOAT images)
+        static bool isFloatFile(std::string const &filename);
 
-        void write_png(std::string const &filename) const;
+        void write_png(std::string const &filename,
+                       int compression = PNG_DEFAULT_COMPRESSION) const;
+        void write_ppm(std::string const &filename) const;
+        void write_pfm(std::string const &filename) const;
         void read_png(std::string const &filename);
 
     private:
-        inline unsigned index(unsigned x, unsigned y) const
+        inline size_t index(unsigned x, unsigned y) const
         {
-            return y * d_width + x;
+            return 3 * (size_t(y) * d_width + x);
         }
 
-        inline unsigned findex(float x, float y) const
+        static uint8_t toByte(Real value)
         {
-            return index(
-                static_cast<unsigned>(x * (d_width - 1)),
-                static_cast<unsigned>(y * (d_height - 1)));
+            return value <= 0 ? 0 : value >= 1 ? 255
+                                  : static_cast<uint8_t>(value * 255);
         }
-
 };
 
+inline void Image::put_pixel(unsigned x, unsigned y, Color const &c)
+{
+    size_t idx = index(x, y);
+    if (d_format == FLOAT)
+    {
+        float *pixel = &d_floats[idx];
+        pixel[0] = c.r;
+        pixel[1] = c.g;
+        pixel[2] = c.b;
+    }
+    else
+    {
+        uint8_t *pixel = &d_bytes[idx];
+        pixel[0] = toByte(c.r);
+        pixel[1] = toByte(c.g);
+        pixel[2] = toByte(c.b);
+    }
+}
+
+inline Color Image::get_pixel(unsigned x, unsigned y) const
+{
+    size_t idx = index(x, y);
+    if (d_format == FLOAT)
+        return Color(d_floats[idx], d_floats[idx + 1], d_floats[idx + 2]);
+
+    Real const scale = Real(1) / 255;
+    return Color(d_bytes[idx] * scale, d_bytes[idx + 1] * scale,
+                 d_bytes[idx + 2] * scale);
+}
+
+inline Color Image::operator()(unsigned x, unsigned y) const
+{
+    return get_pixel(x, y);
+}
+
 #endif
@@ -3,16 +3,11 @@
 
 #include "triple.h"
 
-// Declare LightPtr for use in Scene class
-#include <memory>
-class Light;
-typedef std::shared_ptr<Light> LightPtr;
-
 class Light
 {
     public:
-        Point const position;
-        Color const color;
+        Point position;
+        Color color;
 
         Light(Point const &pos, Color const &c)
         :
@@ -21,4 +16,18 @@ class Light
         {}
 };
 
+// Distance falloff of the point lights: 1 / (constant + linear * d +
+// quadratic * d^2) at distance d. The default keeps the light constant.
+struct Attenuation
+{
+    Real constant = 1;
+    Real linear = 0;
+    Real quadratic = 0;
+
+    Real operator()(Real distance) const
+    {
+        return 1 / (constant + distance * (linear + distance * quadratic));
+    }
+};
+
 #endif
@@ -0,0 +1,136 @@
+#include "lighttree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+void LightTree::build(vector<Light> const &lights)
+{
+    d_nodes.clear();
+    if (lights.empty())
+        return;
+
+    vector<BuildLight> build;
+    build.reserve(lights.size());
+    for (unsigned idx = 0; idx != lights.size(); ++idx)
+    {
+        Color const &color = lights[idx].color;
+        build.push_back(BuildLight{lights[idx].position,
+                                   max(color.r, max(color.g, color.b)), idx});
+    }
+
+    d_nodes.reserve(2 * build.size() - 1);
+    buildRecursive(build, 0, build.size());
+}
+
+bool LightTree::empty() const
+{
+    return d_nodes.empty();
+}
+
+Real LightTree::bound(Node const &node, Point const &p, Vector const &N,
+                      Attenuation const &attenuation)
+{
+    // behind the surface if no corner of the box is in front of it
+    bool front = false;
+    for (unsigned corner = 0; corner != 8 && !front; ++corner)
+    {
+        Point q(corner & 1 ? node.box.max.x : node.box.min.x,
+                corner & 2 ? node.box.max.y : node.box.min.y,
+                corner & 4 ? node.box.max.z : node.box.min.z);
+        front = (q - p).dot(N) > 0;
+    }
+    if (!front)
+        return 0;
+
+    // nearest point of the box
+    Vector offset;
+    for (unsigned axis = 0; axis != 3; ++axis)
+        offset.data[axis] = max(node.box.min.data[axis] - p.data[axis],
+                                max(Real(0), p.data[axis]
+                                             - node.box.max.data[axis]));
+    return node.power * attenuation(offset.length());
+}
+
+bool LightTree::sample(Point const &p, Vector const &N,
+                       Attenuation const &attenuation, Real threshold, Real u,
+                       unsigned &light, Real &pdf) const
+{
+    if (d_nodes.empty())
+        return false;
+
+    auto weight = [&](Node const &node)
+    {
+        Real value = bound(node, p, N, attenuation);
+        return value < threshold ? 0 : value;
+    };
+
+    unsigned node = 0;
+    pdf = 1;
+    if (weight(d_nodes[0]) == 0)
+        return false;
+    while (d_nodes[node].right != 0)
+    {
+        Real left = weight(d_nodes[node + 1]);
+        Real right = weight(d_nodes[d_nodes[node].right]);
+        if (left + right == 0)
+            return false;
+
+        // u is reused for the next level, rescaled to [0, 1)
+        Real pLeft = left / (left + right);
+        if (u < pLeft)
+        {
+            u /= pLeft;
+            pdf *= pLeft;
+            node = node + 1;
+        }
+        else
+        {
+            u = min((u - pLeft) / (1 - pLeft),
+                    1 - numeric_limits<Real>::epsilon());
+            pdf *= 1 - pLeft;
+            node = d_nodes[node].right;
+        }
+    }
+    light = d_nodes[node].light;
+    return true;
+}
+
+// --- Private -----------------------------------------------------------------
+
+// Splits the largest extent of the light positions at the median
+void LightTree::buildRecursive(vector<BuildLight> &lights, unsigned first,
+                               unsigned last)
+{
+    unsigned index = d_nodes.size();
+    d_nodes.push_back(Node());
+    Node node = Node();
+    for (unsigned idx = first; idx != last; ++idx)
+    {
+        node.box.extend(lights[idx].position);
+        node.power += lights[idx].power;
+    }
+
+    if (last - first == 1)
+        node.light = lights[first].index;
+    else
+    {
+        Vector extent = node.box.max - node.box.min;
+        unsigned axis = extent.x > extent.y
+                        ? (extent.x > extent.z ? 0 : 2)
+                        : (extent.y > extent.z ? 1 : 2);
+        unsigned middle = (first + last) / 2;
+        nth_element(lights.begin() + first, lights.begin() + middle,
+                    lights.begin() + last,
+                    [axis](BuildLight const &a, BuildLight const &b)
+                    {
+                        return a.position.data[axis] < b.position.data[axis];
+                    });
+        buildRecursive(lights, first, middle);
+        node.right = d_nodes.size();
+        buildRecursive(lights, middle, last);
+    }
+    d_nodes[index] = node;
+}
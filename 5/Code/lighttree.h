@@ -0,0 +1,111 @@
+#ifndef LIGHTTREE_H_
+#define LIGHTTREE_H_
+
+#include "aabb.h"
+#include "light.h"
+#include "triple.h"
+
+#include <vector>
+
+// How shading uses the light tree (ray --light-samples, --light-cull):
+// with samples > 0 that many lights are picked per hit, else all lights
+// are shaded. Lights and subtrees whose bound is below threshold are
+// skipped. Both 0: the tree is not used, every light is shaded.
+struct LightSampling
+{
+    unsigned samples = 0;
+    Real threshold = 0;
+};
+
+// Hierarchy over the point lights, for scenes with many of them. A node
+// bounds the positions of its lights and sums their power (the largest
+// color component), which bounds the light the node can contribute at a
+// surface point: power * attenuation at the nearest point of the box,
+// zero if the box is entirely behind the surface. Shading then either
+// skips the subtrees whose bound is below a threshold, or picks lights at
+// random with probability proportional to the bounds of the subtrees on
+// the way down, at a cost logarithmic in the number of lights.
+class LightTree
+{
+    public:
+        enum { MAX_DEPTH = 64 };
+
+        // depth first like BVH::Node: the left child follows its parent
+        struct Node
+        {
+            AABB box;
+            Real power;
+            unsigned light;     // leaf: index in the scene's lights
+            unsigned right;     // interior: index of the right child, 0 leaf
+        };
+
+    private:
+        std::vector<Node> d_nodes;
+
+    public:
+        void build(std::vector<Light> const &lights);
+        bool empty() const;
+
+        // Bound on the light (per color channel) that the node contributes
+        // at p, on the side of N
+        static Real bound(Node const &node, Point const &p, Vector const &N,
+                          Attenuation const &attenuation);
+
+        // Calls visit(light) for every light of a subtree whose bound at p
+        // is at least threshold
+        template <typename Visitor>
+        void cull(Point const &p, Vector const &N,
+                  Attenuation const &attenuation, Real threshold,
+                  Visitor &&visit) const;
+
+        // Picks a light with probability proportional to the bounds, u is
+        // uniform in [0, 1). Subtrees below threshold are never picked.
+        // Returns false if no light can contribute.
+        bool sample(Point const &p, Vector const &N,
+                    Attenuation const &attenuation, Real threshold, Real u,
+                    unsigned &light, Real &pdf) const;
+
+    private:
+        struct BuildLight
+        {
+            Point position;
+            Real power;
+            unsigned index;
+        };
+
+        void buildRecursive(std::vector<BuildLight> &lights, unsigned first,
+                            unsigned last);
+};
+
+template <typename Visitor>
+void LightTree::cull(Point const &p, Vector const &N,
+                     Attenuation const &attenuation, Real threshold,
+                     Visitor &&visit) const
+{
+    if (d_nodes.empty())
+        return;
+
+    unsigned stack[MAX_DEPTH];
+    unsigned top = 0;
+    unsigned node = 0;
+    while (true)
+    {
+        Node const &current = d_nodes[node];
+        if (bound(current, p, N, attenuation) >= threshold)
+        {
+            if (current.right == 0)
+                visit(current.light);
+            else
+            {
+                stack[top++] = current.right;
+                node = node + 1;
+                continue;
+            }
+        }
+        if (top == 0)
+            return;
+        node = stack[--top];
+    }
+}
+
+#endif
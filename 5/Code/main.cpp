@@ -1,6 +1,8 @@
 #include "raytracer.h"
 
+#include <exception>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 
 using namespace std;
@@ -9,36 +11,234 @@ int main(int argc, char *argv[])
 {
     cout << "Introduction to Computer Graphics - Raytracer\n\n";
 
-    if (argc < 2 || argc > 3)
+    Raytracer raytracer;
+
+    // options precede the in- and out-file
+    int arg = 1;
+    unsigned tileSize = 16;
+    string tileOrder = "hilbert";
+    string cacheFile;
+    bool progressive = false;
+    ProgressiveOptions progressiveOptions;
+    bool adaptive = false;
+    AdaptiveOptions adaptiveOptions;
+    bool animation = false;
+    LightSampling lightSampling;
+    bool distributed = false;
+    DistributedOptions distributedOptions;
+    string workerAddress;
+    try
     {
-        cerr << "Usage: " << argv[0] << "in-file [out-file.png]\n";
+        for (; arg < argc && string(argv[arg]).compare(0, 2, "--") == 0; ++arg)
+        {
+            string option(argv[arg]);
+            bool hasValue = arg + 1 < argc;
+            int first = arg;
+
+            // options of distributed rendering itself, not passed on to
+            // spawned workers
+            if (option == "--coordinator" && hasValue)
+            {
+                distributed = true;
+                distributedOptions.port = stoul(argv[++arg]);
+                continue;
+            }
+            else if (option == "--spawn" && hasValue)
+            {
+                distributed = true;
+                distributedOptions.spawn = stoul(argv[++arg]);
+                continue;
+            }
+            else if (option == "--job-size" && hasValue)
+            {
+                distributedOptions.tileSize = stoul(argv[++arg]);
+                continue;
+            }
+            else if (option == "--worker-timeout" && hasValue)
+            {
+                distributedOptions.timeout = stod(argv[++arg]);
+                continue;
+            }
+            else if (option == "--worker" && hasValue)
+            {
+                workerAddress = argv[++arg];
+                continue;
+            }
+
+            if (option == "--no-bvh")
+                raytracer.setUseBVH(false);
+            else if (option == "--packets")
+                raytracer.setPacketWidth(MAX_PACKET_WIDTH);
+            else if (option == "--packet-width" && hasValue)
+                raytracer.setPacketWidth(stoul(argv[++arg]));
+            else if (option == "--wavefront")
+                raytracer.setWavefront(true);
+            else if (option == "--resolution" && hasValue)
+            {
+                // WIDTHxHEIGHT
+                string value(argv[++arg]);
+                size_t sep = value.find('x');
+                if (sep == string::npos)
+                    throw invalid_argument("resolution " + value);
+                raytracer.setResolution(stoul(value.substr(0, sep)),
+                                        stoul(value.substr(sep + 1)));
+            }
+            else if (option == "--threads" && hasValue)
+                raytracer.setThreads(stoul(argv[++arg]));
+            else if (option == "--tile-size" && hasValue)
+                tileSize = stoul(argv[++arg]);
+            else if (option == "--tile-order" && hasValue)
+                tileOrder = argv[++arg];
+            else if (option == "--tile-stats" && hasValue)
+                raytracer.setTileStatsFile(argv[++arg]);
+            else if (option == "--stats")
+                raytracer.setWriteStats(true);
+            else if (option == "--progressive")
+                progressive = true;
+            else if (option == "--time-budget" && hasValue)
+            {
+                progressive = true;
+                progressiveOptions.timeBudget = stod(argv[++arg]);
+            }
+            else if (option == "--samples" && hasValue)
+            {
+                progressive = true;
+                progressiveOptions.samples = stoul(argv[++arg]);
+            }
+            else if (option == "--adaptive" && hasValue)
+            {
+                adaptive = true;
+                adaptiveOptions.maxSamples = stoul(argv[++arg]);
+            }
+            else if (option == "--adaptive-min" && hasValue)
+                adaptiveOptions.minSamples = stoul(argv[++arg]);
+            else if (option == "--adaptive-threshold" && hasValue)
+                adaptiveOptions.threshold = stod(argv[++arg]);
+            else if (option == "--sample-heatmap" && hasValue)
+                raytracer.setSampleHeatmapFile(argv[++arg]);
+            else if (option == "--png-level" && hasValue)
+                raytracer.setCompression(stoi(argv[++arg]));
+            else if (option == "--light-samples" && hasValue)
+                lightSampling.samples = stoul(argv[++arg]);
+            else if (option == "--light-cull" && hasValue)
+                lightSampling.threshold = stod(argv[++arg]);
+            else if (option == "--animation")
+                animation = true;
+            else if (option == "--compile-scene" && hasValue)
+                cacheFile = argv[++arg];
+            else
+            {
+                cerr << "Unknown option: " << option << '\n';
+                return 1;
+            }
+            // spawned workers render with the same options
+            distributedOptions.workerArgs.insert(
+                distributedOptions.workerArgs.end(), argv + first,
+                argv + arg + 1);
+        }
+        raytracer.setTiling(tileSize, tileOrder);
+        if (progressive)
+            raytracer.setProgressive(progressiveOptions);
+        if (adaptive)
+            raytracer.setAdaptiveSampling(adaptiveOptions);
+        raytracer.setLightSampling(lightSampling);
+    }
+    catch (exception const &ex)
+    {
+        cerr << "Invalid option value: " << ex.what() << '\n';
         return 1;
     }
 
-    Raytracer raytracer;
+    if (!workerAddress.empty())
+        return raytracer.renderAsWorker(workerAddress) ? 0 : 1;
+
+    if (distributed && progressive)
+    {
+        cerr << "Progressive rendering cannot be distributed.\n";
+        return 1;
+    }
+
+    if (argc - arg < 1 || argc - arg > 2)
+    {
+        cerr << "Usage: " << argv[0] << " [options] in-file [out-file]\n\n"
+             << "Options:\n"
+             << "  --no-bvh              test all objects for every ray\n"
+             << "  --packets             trace primary rays in SIMD packets\n"
+             << "  --packet-width N      packets of at most N (4, 8, 16) rays,\n"
+             << "                        0 traces scalar rays\n"
+             << "  --wavefront           trace tiles bounce by bounce, with\n"
+             << "                        secondary rays sorted for coherence\n"
+             << "  --resolution WxH      output size (default: camera viewSize)\n"
+             << "  --threads N           render threads (default: all cores)\n"
+             << "  --tile-size N         render in N x N pixel tiles (16)\n"
+             << "  --tile-order ORDER    scanline, morton or hilbert (default)\n"
+             << "  --tile-stats FILE     write the time per tile as CSV\n"
+             << "  --stats               write timings and ray counts as JSON\n"
+             << "                        next to the image (.stats.json)\n"
+             << "  --progressive         render in passes of increasing quality,\n"
+             << "                        rewriting the image after each pass\n"
+             << "  --time-budget S       progressive, stop after S seconds\n"
+             << "  --samples N           progressive, stop at N samples per\n"
+             << "                        pixel (default SuperSamplingFactor^2)\n"
+             << "  --adaptive N          adaptive supersampling, at most N\n"
+             << "                        samples per pixel (scalar rays)\n"
+             << "  --adaptive-min N      samples added at a time (4)\n"
+             << "  --adaptive-threshold T  stop at this standard error of\n"
+             << "                        the pixel color (0.005)\n"
+             << "  --sample-heatmap FILE write the samples per pixel as PNG\n"
+             << "  --png-level N         PNG compression, 0 (store) to 9 (6)\n"
+             << "  --light-samples N     shade N lights per hit, picked by\n"
+             << "                        their contribution (light tree)\n"
+             << "  --light-cull T        skip lights contributing less than T\n"
+             << "  --animation           in-file is an animation, out-file\n"
+             << "                        the frame names (e.g. f%04d.png)\n"
+             << "  --coordinator PORT    render with worker processes that\n"
+             << "                        connect to PORT (0: any free port)\n"
+             << "  --spawn N             coordinator, start N local workers\n"
+             << "                        with the other options\n"
+             << "  --job-size N          coordinator, hand out N x N pixel\n"
+             << "                        tiles (256)\n"
+             << "  --worker-timeout S    coordinator, reissue the tiles of a\n"
+             << "                        worker silent for S seconds\n"
+             << "  --worker HOST:PORT    render tiles for a coordinator, no\n"
+             << "                        in-file\n"
+             << "  --compile-scene FILE  write the scene as a binary scene\n"
+             << "                        cache instead of rendering it, the\n"
+             << "                        cache is read in place of the JSON\n";
+        return 1;
+    }
+
+    if (animation)
+        return raytracer.renderAnimation(argv[arg],
+                                         argc - arg == 2 ? argv[arg + 1] : "")
+               ? 0 : 1;
 
     // read the scene
-    if (!raytracer.readScene(argv[1]))
+    if (!raytracer.readScene(argv[arg]))
     {
-        cerr << "Error: reading scene from " << argv[1] <<
+        cerr << "Error: reading scene from " << argv[arg] <<
             " failed - no output generated.\n";
         return 1;
     }
 
+    if (!cacheFile.empty())
+        return raytracer.compileScene(cacheFile) ? 0 : 1;
+
     // determine output name
     string ofname;
-    if (argc >= 3)
+    if (argc - arg == 2)
     {
-        ofname = argv[2];   // use the provided name
+        ofname = argv[arg + 1];   // use the provided name
     }
     else
     {
-        ofname = argv[1];   // replace .json with .png
+        ofname = argv[arg];   // replace .json with .png
         ofname.erase(ofname.begin() + ofname.find_last_of('.'), ofname.end());
         ofname += ".png";
     }
 
-    raytracer.renderToFile(ofname);
+    if (distributed)
+        return raytracer.renderDistributed(ofname, distributedOptions) ? 0 : 1;
 
-    return 0;
+    return raytracer.renderToFile(ofname) ? 0 : 1;
 }
@@ -0,0 +1,37 @@
+#include "mappedfile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+using namespace std;
+
+MappedFile::MappedFile(string const &filename)
+{
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw runtime_error("Could not open: " + filename + " for reading!");
+
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void *data = mmap(nullptr, info.st_size, PROT_READ,
+                          MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            d_data = static_cast<char const *>(data);
+            d_size = info.st_size;
+            madvise(data, d_size, MADV_SEQUENTIAL);
+        }
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (d_data)
+        munmap(const_cast<char *>(d_data), d_size);
+}
@@ -0,0 +1,26 @@
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+
+#include <cstddef>
+#include <string>
+
+// Read only view of a whole file through mmap. An empty file (or one that
+// could not be mapped) gives an empty range.
+class MappedFile
+{
+    char const *d_data = nullptr;
+    size_t d_size = 0;
+
+    public:
+        explicit MappedFile(std::string const &filename);
+        ~MappedFile();
+
+        MappedFile(MappedFile const &) = delete;
+        MappedFile &operator=(MappedFile const &) = delete;
+
+        char const *begin() const { return d_data; }
+        char const *end() const { return d_data + d_size; }
+        size_t size() const { return d_size; }
+};
+
+#endif
@@ -7,14 +7,16 @@ class Material
 {
     public:
         Color color;        // base color
-        double ka;          // ambient intensity
-        double kd;          // diffuse intensity
-        double ks;          // specular intensity
-        double n;           // exponent for specular highlight size
+        Real ka;            // ambient intensity
+        Real kd;            // diffuse intensity
+        Real ks;            // specular intensity
+        Real n;             // exponent for specular highlight size
+        int texture = -1;   // replaces color: index of the scene's texture,
+                            // -1 for none
 
         Material() = default;
 
-        Material(Color const &color, double ka, double kd, double ks, double n)
+        Material(Color const &color, Real ka, Real kd, Real ks, Real n)
         :
             color(color),
             ka(ka),
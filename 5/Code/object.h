@@ -1,26 +1,120 @@
 #ifndef OBJECT_H_
 #define OBJECT_H_
 
+#include "aabb.h"
 #include "material.h"
+#include "packet.h"
+#include "renderstats.h"
 
 // not really needed here, but deriving classes may need them
 #include "hit.h"
 #include "ray.h"
 #include "triple.h"
 
-#include <memory>
-class Object;
-typedef std::shared_ptr<Object> ObjectPtr;
+#include <cstdint>
+#include <limits>
+
+// The concrete type of the built in shapes. Scene intersects these through
+// their (final) classes, so their intersection code is inlined into the
+// traversal instead of called virtually. Other shapes are OTHER and are
+// intersected through the virtual functions.
+enum class ShapeKind : uint8_t
+{
+    SPHERE,
+    PLANE,
+    TRIANGLE,
+    OTHER
+};
 
 class Object
 {
     public:
         Material material;
+        ShapeKind const kind;
+
+        explicit Object(ShapeKind kind = ShapeKind::OTHER)
+        :
+            kind(kind)
+        {}
 
         virtual ~Object() = default;
 
         virtual Hit intersect(Ray const &ray) = 0;  // must be implemented
                                                     // in derived class
+
+        // Closest hit in two steps, so the normal is only computed for the
+        // object that wins the depth test: distance() returns the distance
+        // to the closest hit (infinity if there is none) and, for objects
+        // made of several primitives, which one was hit. normal() then gives
+        // the normal at that hit. Both default to intersect().
+        virtual Real distance(Ray const &ray, unsigned &prim)
+        {
+            ++threadCounters().tests[RayCounters::OTHER];
+            prim = 0;
+            Real t = intersect(ray).t;
+            return t == t ? t : std::numeric_limits<Real>::infinity();
+        }
+
+        virtual Vector normal(Ray const &ray, Real t, unsigned prim)
+        {
+            return intersect(ray).N;
+        }
+
+        // Whether anything is hit closer than tMax (shadow rays), no normal
+        // is computed and objects may stop at the first hit they find
+        virtual bool occluded(Ray const &ray, Real tMax)
+        {
+            unsigned prim;
+            return distance(ray, prim) < tMax;
+        }
+
+        // Texture coordinates (u, v), both 0 .. 1, of the surface point p
+        // and the size in world units that one unit of u spans there (to
+        // select the texture's mip level). Shapes without a mapping return
+        // false, they are not textured.
+        virtual bool textureCoordinates(Point const &p, Real &u, Real &v,
+                                        Real &size) const
+        {
+            return false;
+        }
+
+        // bounds used by the acceleration structure, objects without a
+        // finite extent return AABB::infinite()
+        virtual AABB boundingBox() const = 0;
+
+        // Intersect a packet of rays, updating the lanes of hit where this
+        // object (identified by id) is closer. Shapes with a SIMD kernel
+        // override this; the default intersects lane by lane.
+        virtual void intersectPacket(RayPacket const &packet, PacketHit &hit,
+                                     int id, PacketKernels const &kernels)
+        {
+            threadCounters().tests[RayCounters::OTHER] += kernels.width;
+            for (unsigned lane = 0; lane != kernels.width; ++lane)
+            {
+                Ray ray(Point(packet.ox[lane], packet.oy[lane], packet.oz[lane]),
+                        Vector(packet.dx[lane], packet.dy[lane], packet.dz[lane]));
+                Hit candidate(intersect(ray));
+                if (candidate.t < hit.t[lane])
+                {
+                    hit.t[lane] = candidate.t;
+                    hit.nx[lane] = candidate.N.x;
+                    hit.ny[lane] = candidate.N.y;
+                    hit.nz[lane] = candidate.N.z;
+                    hit.id[lane] = id;
+                }
+            }
+        }
+
+    protected:
+        // intersect() for shapes implementing distance() and normal()
+        Hit deferredHit(Ray const &ray)
+        {
+            unsigned prim;
+            Real t = distance(ray, prim);
+            if (t == std::numeric_limits<Real>::infinity())
+                return Hit::NO_HIT();
+            return Hit(t, normal(ray, t, prim));
+        }
 };
 
 #endif
@@ -3,13 +3,162 @@
 // Pro C++ Tip: here you can specify other includes you may need
 // such as <iostream>
 
-#include <fstream>
+#include "mappedfile.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
-#include <sstream>
-#include <limits>
+#include <stdexcept>
+#include <string>
 
 using namespace std;
 
+namespace
+{
+    // Chunks are about this large, cut at line ends
+    size_t const CHUNK_SIZE = 1 << 20;
+
+    inline bool isSpace(char ch)
+    {
+        return ch == ' ' || ch == '\t' || ch == '\r';
+    }
+
+    inline bool isDigit(char ch)
+    {
+        return ch >= '0' && ch <= '9';
+    }
+
+    inline void skipSpace(char const *&ptr, char const *end)
+    {
+        while (ptr != end && isSpace(*ptr))
+            ++ptr;
+    }
+
+    // Parses a decimal number at ptr. Numbers with at most 19 significant
+    // digits and small exponents (all numbers OBJ exporters write) take an
+    // exact integer mantissa scaled by an exact power of ten, anything else
+    // is handed to strtod.
+    bool parseFloat(char const *&ptr, char const *end, float &value)
+    {
+        static double const POW10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+        skipSpace(ptr, end);
+        char const *start = ptr;
+
+        bool negative = false;
+        if (ptr != end && (*ptr == '-' || *ptr == '+'))
+            negative = *ptr++ == '-';
+
+        unsigned long long mantissa = 0;
+        int digits = 0;             // significant digits in mantissa
+        int exponent = 0;
+        bool any = false;
+        bool truncated = false;
+        for (; ptr != end && isDigit(*ptr); ++ptr, any = true)
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*ptr - '0');
+                digits += mantissa != 0;
+            }
+            else
+            {
+                truncated = truncated || *ptr != '0';
+                ++exponent;
+            }
+        }
+        if (ptr != end && *ptr == '.')
+        {
+            for (++ptr; ptr != end && isDigit(*ptr); ++ptr, any = true)
+            {
+                if (digits < 19)
+                {
+                    mantissa = mantissa * 10 + (*ptr - '0');
+                    digits += mantissa != 0;
+                    --exponent;
+                }
+                else
+                    truncated = truncated || *ptr != '0';
+            }
+        }
+
+        if (any && ptr != end && (*ptr == 'e' || *ptr == 'E'))
+        {
+            char const *mark = ptr++;
+            bool negativeExp = false;
+            if (ptr != end && (*ptr == '-' || *ptr == '+'))
+                negativeExp = *ptr++ == '-';
+            if (ptr == end || !isDigit(*ptr))
+                ptr = mark;     // not an exponent after all
+            else
+            {
+                int exp = 0;
+                for (; ptr != end && isDigit(*ptr); ++ptr)
+                    exp = min(exp * 10 + (*ptr - '0'), 10000);
+                exponent += negativeExp ? -exp : exp;
+            }
+        }
+
+        // the mantissa and the power of ten are exact doubles, so the result
+        // is correctly rounded
+        if (any && !truncated && mantissa <= (1ULL << 53)
+            && exponent >= -22 && exponent <= 22)
+        {
+            double result = exponent < 0 ? mantissa / POW10[-exponent]
+                                         : mantissa * POW10[exponent];
+            value = static_cast<float>(negative ? -result : result);
+            return true;
+        }
+
+        // long mantissas, huge exponents, inf, nan: strtod on a terminated
+        // copy of the token (the mapping is not 0 terminated)
+        ptr = start;
+        while (ptr != end && !isSpace(*ptr) && *ptr != '\n')
+            ++ptr;
+        string token(start, ptr);
+        char *stop;
+        double result = strtod(token.c_str(), &stop);
+        value = static_cast<float>(result);
+        return stop != token.c_str() && *stop == '\0';
+    }
+
+    // an OBJ index: 1 based, or negative to count back from the last
+    // element read so far (-1); 0 if absent
+    inline long long parseIndex(char const *&ptr, char const *end)
+    {
+        bool negative = ptr != end && *ptr == '-';
+        if (negative)
+            ++ptr;
+        long long index = 0;
+        for (; ptr != end && isDigit(*ptr); ++ptr)
+            index = index * 10 + (*ptr - '0');
+        return negative ? -index : index;
+    }
+
+    // 0 based index of an OBJ index, count elements of its kind were read
+    // before it in the chunk. A negative (relative) index adds field to
+    // relative, it becomes absolute when merge adds the elements of the
+    // chunks before; invalid ones end up out of range.
+    inline size_t toIndex(long long index, size_t count, unsigned field,
+                          unsigned &relative)
+    {
+        if (index >= 0)
+            return static_cast<size_t>(index) - 1U;
+        relative |= field;
+        return count + static_cast<size_t>(index);
+    }
+
+    inline char const *lineEnd(char const *ptr, char const *end)
+    {
+        while (ptr != end && *ptr != '\n')
+            ++ptr;
+        return ptr;
+    }
+}
+
 // ===================================================================
 // -- Constructors and destructor ------------------------------------
 // ===================================================================
@@ -29,41 +178,9 @@ OBJLoader::OBJLoader(string const &filename)
 
 // --- Public --------------------------------------------------------
 
-vector<Vertex> OBJLoader::vertex_data() const
+vector<Vertex> const &OBJLoader::vertex_data() const
 {
-    vector<Vertex> data;
-
-    // For all vertices in the model, interleave the data
-    for (Vertex_idx const &vertex : d_vertices)
-    {
-        // Add coordinate data
-        Vertex vert;
-
-        vec3 const coord = d_coordinates.at(vertex.d_coord);
-        vert.x = coord.x;
-        vert.y = coord.y;
-        vert.z = coord.z;
-
-        // Add normal data
-        vec3 const norm = d_normals.at(vertex.d_norm);
-        vert.nx = norm.x;
-        vert.ny = norm.y;
-        vert.nz = norm.z;
-
-        // Add texture data (if available)
-        if (d_hasTexCoords)
-        {
-            vec2 const tex = d_texCoords.at(vertex.d_tex);
-            vert.u = tex.u;      // u coordinate
-            vert.v = tex.v;      // v coordinate
-        } else {
-            vert.u = 0;
-            vert.v = 0;
-        }
-        data.push_back(vert);
-    }
-
-    return data;    // copy elision
+    return d_vertexData;
 }
 
 unsigned OBJLoader::numTriangles() const
@@ -76,229 +193,213 @@ bool OBJLoader::hasTexCoords() const
     return d_hasTexCoords;
 }
 
-void OBJLoader::unitize()
-{
-
-    // This is a very handy function for importing models
-    // which you may reuse in other projects.
-    // You may have noticed you can use arbitrary sizes for your
-    // models. You may find that modelers do not always use the
-    // same size for models. Therefore it might be preferable to
-    // scale the object to fit inside the unit cube so you can easily
-    // set the right scale of your model in OpenGL. Aditionally,
-    // the model does not have to be centered around the origin
-    // (0, 0, 0) which may cause troubles when translating
-    // This function should fix that!
-
-    // A common approach looks like this:
-
-    // Determine min / max and offset in each dimension
-    // Determine by which factor to scale (largest difference
-    //  in min / max in a dimension (Important! Scale uniformaly in
-    //  all dimensions!)
-    // Loop over all coordinate data and scale the coordinates
-    //  and apply the translate/scaling
-
-    vector<Vertex> v = this->vertex_data();
-    unsigned int size = v.size();
-    double scale = 2.0 / getMaxLength(v, static_cast <double> (size));
-
-#pragma omp parallel for 
-    for (unsigned int i = 0; i < size; i++) {
-        v[i].x *= scale;
-        v[i].y *= scale;
-        v[i].z *= scale;
-    }
-}
-
 // --- Private -------------------------------------------------------
-/**
- * @brief getXLength Calculates the length of the element (assuming the vertexes composes an element) from the X axis perspective.
- * @param v Vertexes
- * @param N Number of vertexes
- * @return X Length
- */
-float OBJLoader::getXLength(vector<Vertex> v, int N)
+
+void OBJLoader::parseFile(string const &filename)
 {
-    float min = std::numeric_limits<float>::max(), max = -std::numeric_limits<float>::max();
-    for (int i = 0; i < N; i++)
+    MappedFile file(filename);
+
+    // whole lines per chunk: a chunk ends after the first newline
+    // following CHUNK_SIZE bytes
+    vector<char const *> bounds(1, file.begin());
+    while (bounds.back() != file.end())
     {
-        if (v[i].x < min)
-        {
-            min = v[i].x;
-        }
-        else if (v[i].x > max)
-        {
-            max = v[i].x;
-        }
+        char const *start = bounds.back();
+        size_t left = file.end() - start;
+        char const *cut = start + min(left, CHUNK_SIZE);
+        cut = lineEnd(cut, file.end());
+        bounds.push_back(cut == file.end() ? cut : cut + 1);
     }
-    return (max - min);
+
+    vector<Chunk> chunks(bounds.size() - 1);
+    int const numChunks = chunks.size();
+#pragma omp parallel for schedule(dynamic)
+    for (int idx = 0; idx < numChunks; ++idx)
+        parseChunk(bounds[idx], bounds[idx + 1], chunks[idx]);
+
+    for (Chunk const &chunk : chunks)
+        if (chunk.error)
+            throw runtime_error("Malformed number in " + filename);
+
+    merge(chunks);
+    buildVertexData();
 }
 
-/**
- * @brief getYLength Calculates the length of the element (assuming the vertexes composes an element) from the Z axis perspective.
- * @param v Vertexes
- * @param N Number of vertexes
- * @return Y Length
- */
-float OBJLoader::getYLength(vector<Vertex> v, int N)
+// Parses the lines in [begin, end). Faces hold absolute (1 based)
+// indices, so chunks do not depend on each other.
+void OBJLoader::parseChunk(char const *begin, char const *end, Chunk &chunk)
 {
-    float min = std::numeric_limits<float>::max(), max = -std::numeric_limits<float>::max();
-    for (int i = 0; i < N; i++)
+    char const *ptr = begin;
+    while (ptr != end)
     {
-        if (v[i].y < min)
-        {
-            min = v[i].y;
-        }
-        else if (v[i].y > max)
+        skipSpace(ptr, end);
+        char const *eol = lineEnd(ptr, end);
+
+        // the keyword: "v", "vn", "vt" or "f" (compared in place), other
+        // data is ignored
+        char const *keyEnd = ptr;
+        while (keyEnd != eol && !isSpace(*keyEnd))
+            ++keyEnd;
+        size_t const keyLength = keyEnd - ptr;
+        bool const isV = keyLength == 1 && ptr[0] == 'v';
+        bool const isVn = keyLength == 2 && memcmp(ptr, "vn", 2) == 0;
+        bool const isVt = keyLength == 2 && memcmp(ptr, "vt", 2) == 0;
+        bool const isF = keyLength == 1 && ptr[0] == 'f';
+        ptr = keyEnd;
+
+        if (isV || isVn)
         {
-            max = v[i].y;
+            float x = 0, y = 0, z = 0;
+            bool ok = parseFloat(ptr, eol, x) && parseFloat(ptr, eol, y)
+                   && parseFloat(ptr, eol, z);
+            if (isV)
+                chunk.coordinates.push_back(vec3{x, y, z});
+            else
+                chunk.normals.push_back(vec3{x, y, z});
+            chunk.error = chunk.error || !ok;
         }
-    }
-    return (max - min);
-}
-
-/**
- * @brief getZLength Calculates the length of the element (assuming the vertexes composes an element) from the Z axis perspective.
- * @param v Vertexes
- * @param N Number of vertexes
- * @return Z Length
- */
-float OBJLoader::getZLength(vector<Vertex> v, int N)
-{
-    float min = std::numeric_limits<float>::max(), max = -std::numeric_limits<float>::max();
-    for (int i = 0; i < N; i++)
-    {
-        if (v[i].z < min)
+        else if (isVt)
         {
-            min = v[i].z;
+            float u = 0, v = 0;
+            bool ok = parseFloat(ptr, eol, u) && parseFloat(ptr, eol, v);
+            chunk.texCoords.push_back(vec2{u, v});
+            chunk.error = chunk.error || !ok;
         }
-        else if (v[i].z > max)
+        else if (isF)
         {
-            max = v[i].z;
+            // format is:
+            // <vertex idx + 1>/<texture idx +1>/<normal idx + 1>
+            // Wavefront .obj files start counting from 1 (yuck)
+            while (true)
+            {
+                skipSpace(ptr, eol);
+                if (ptr == eol || !(isDigit(*ptr) || *ptr == '-'))
+                    break;
+
+                Vertex_idx vertex {}; // initialize to zeros on all fields
+                unsigned relative = 0;
+                vertex.d_coord = toIndex(parseIndex(ptr, eol),
+                                         chunk.coordinates.size(),
+                                         Chunk::COORD, relative);
+                if (ptr != eol && *ptr == '/')
+                {
+                    ++ptr;
+                    long long tex = parseIndex(ptr, eol);
+                    if (tex != 0)
+                        vertex.d_tex = toIndex(tex, chunk.texCoords.size(),
+                                               Chunk::TEX, relative);
+                    if (ptr != eol && *ptr == '/')
+                    {
+                        ++ptr;
+                        long long norm = parseIndex(ptr, eol);
+                        if (norm != 0)
+                            vertex.d_norm = toIndex(norm, chunk.normals.size(),
+                                                    Chunk::NORM, relative);
+                    }
+                }
+                if (relative != 0)
+                    chunk.relative.push_back(
+                        make_pair(chunk.vertices.size(), relative));
+                chunk.vertices.push_back(vertex);
+
+                while (ptr != eol && !isSpace(*ptr))
+                    ++ptr;
+            }
         }
+
+        ptr = eol == end ? end : eol + 1;
     }
-    return (max - min);
 }
 
-/**
- * @brief getMaxLength Returns the greatest length from the 3 axis perspective of a model.
- * @param v Model.
- * @param N Number of vertexes.
- * @return Greatest length.
- */
-float OBJLoader::getMaxLength(vector<Vertex> v, int N)
+// append the chunks in file order
+void OBJLoader::merge(vector<Chunk> const &chunks)
 {
-    float max = getXLength(v, N), tmp;
-
-    if ((tmp = getYLength(v, N)) > max)
-    {
-        max = tmp;
-    }
-
-    if ((tmp = getZLength(v, N)) > max)
+    size_t numCoords = 0, numNormals = 0, numTex = 0, numVertices = 0;
+    for (Chunk const &chunk : chunks)
     {
-        max = tmp;
+        numCoords += chunk.coordinates.size();
+        numNormals += chunk.normals.size();
+        numTex += chunk.texCoords.size();
+        numVertices += chunk.vertices.size();
     }
 
-    return max;
-}
-void OBJLoader::parseFile(string const &filename)
-{
-    ifstream file(filename);
-    if (file)
+    d_coordinates.reserve(numCoords);
+    d_normals.reserve(numNormals);
+    d_texCoords.reserve(numTex);
+    d_vertices.reserve(numVertices);
+    for (Chunk const &chunk : chunks)
     {
-        string line;
-        while(getline(file, line))
-            parseLine(line);
-
-    } else {
-        cerr << "Could not open: " << filename << " for reading!\n";
+        // relative indices count from the start of the chunk
+        size_t const first = d_vertices.size();
+        size_t const coords = d_coordinates.size();
+        size_t const normals = d_normals.size();
+        size_t const texCoords = d_texCoords.size();
+        d_coordinates.insert(d_coordinates.end(), chunk.coordinates.begin(),
+                             chunk.coordinates.end());
+        d_normals.insert(d_normals.end(), chunk.normals.begin(),
+                         chunk.normals.end());
+        d_texCoords.insert(d_texCoords.end(), chunk.texCoords.begin(),
+                           chunk.texCoords.end());
+        d_vertices.insert(d_vertices.end(), chunk.vertices.begin(),
+                          chunk.vertices.end());
+        for (pair<size_t, unsigned> const &entry : chunk.relative)
+        {
+            Vertex_idx &vertex = d_vertices[first + entry.first];
+            if (entry.second & Chunk::COORD)
+                vertex.d_coord += coords;
+            if (entry.second & Chunk::TEX)
+                vertex.d_tex += texCoords;
+            if (entry.second & Chunk::NORM)
+                vertex.d_norm += normals;
+        }
     }
+    d_hasTexCoords = numTex != 0;      // Texture data was read
 }
 
-void OBJLoader::parseLine(string const &line)
+// For all vertices in the model, interleave the data
+void OBJLoader::buildVertexData()
 {
-    if (line[0] == '#')
-        return;                     // ignore comments
-
-    StringList tokens = split(line, ' ', false);
+    d_vertexData.resize(d_vertices.size());
 
-    if (tokens[0] == "v")
-        parseVertex(tokens);
-    else if (tokens[0] == "vn")
-        parseNormal(tokens);
-    else if (tokens[0] == "vt")
-        parseTexCoord(tokens);
-    else if (tokens[0] == "f")
-        parseFace(tokens);
-
-    // Other data is also ignored
-}
-
-void OBJLoader::parseVertex(StringList const &tokens)
-{
-    float x, y, z;
-    x = stof(tokens.at(1));         // 0 is the "v" token
-    y = stof(tokens.at(2));
-    z = stof(tokens.at(3));
-    d_coordinates.push_back(vec3{x, y, z});
-}
-
-void OBJLoader::parseNormal(StringList const &tokens)
-{
-    float x, y, z;
-    x = stof(tokens.at(1));         // 0 is the "vn" token
-    y = stof(tokens.at(2));
-    z = stof(tokens.at(3));
-    d_normals.push_back(vec3{x, y, z});
-}
-
-void OBJLoader::parseTexCoord(StringList const &tokens)
-{
-    d_hasTexCoords = true;          // Texture data will be read
-
-    float u, v;
-    u = stof(tokens.at(1));         // 0 is the "vt" token
-    v = stof(tokens.at(2));
-    d_texCoords.push_back(vec2{u, v});
-}
-
-void OBJLoader::parseFace(StringList const &tokens)
-{
-    // skip the first token ("f")
-    for (size_t idx = 1; idx < tokens.size(); ++idx)
+    bool badIndex = false;
+    int const numVertices = d_vertices.size();
+#pragma omp parallel for reduction(||: badIndex)
+    for (int idx = 0; idx < numVertices; ++idx)
     {
-        // format is:
-        // <vertex idx + 1>/<texture idx +1>/<normal idx + 1>
-        // Wavefront .obj files start counting from 1 (yuck)
+        Vertex_idx const &vertex = d_vertices[idx];
+        Vertex &vert = d_vertexData[idx];
+        if (vertex.d_coord >= d_coordinates.size()
+            || vertex.d_norm >= d_normals.size()
+            || (d_hasTexCoords && vertex.d_tex >= d_texCoords.size()))
+        {
+            badIndex = true;
+            continue;
+        }
 
-        StringList elements = split(tokens.at(idx), '/');
-        Vertex_idx vertex {}; // initialize to zeros on all fields
+        // Add coordinate data
+        vec3 const coord = d_coordinates[vertex.d_coord];
+        vert.x = coord.x;
+        vert.y = coord.y;
+        vert.z = coord.z;
 
-        vertex.d_coord = stoul(elements.at(0)) - 1U;
+        // Add normal data
+        vec3 const norm = d_normals[vertex.d_norm];
+        vert.nx = norm.x;
+        vert.ny = norm.y;
+        vert.nz = norm.z;
 
+        // Add texture data (if available)
         if (d_hasTexCoords)
-            vertex.d_tex = stoul(elements.at(1)) - 1U;
-        else
-            vertex.d_tex = 0U;       // ignored
-
-        vertex.d_norm = stoul(elements.at(2)) - 1U;
-
-        d_vertices.push_back(vertex);
+        {
+            vec2 const tex = d_texCoords[vertex.d_tex];
+            vert.u = tex.u;      // u coordinate
+            vert.v = tex.v;      // v coordinate
+        } else {
+            vert.u = 0;
+            vert.v = 0;
+        }
     }
-}
 
-OBJLoader::StringList OBJLoader::split(string const &line,
-        char splitChar,
-        bool keepEmpty)
-{
-    StringList tokens;
-    istringstream iss(line);
-    string token;
-    while (getline(iss, token, splitChar))
-        if (token.size() > 0 || (token.size() == 0 && keepEmpty))
-            tokens.push_back(token);
-
-    return tokens;
+    if (badIndex)
+        throw out_of_range("OBJ face refers to a missing vertex, normal or texture coordinate");
 }
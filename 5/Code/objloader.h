@@ -8,6 +8,7 @@
 #include "vertex.h"
 
 #include <string>
+#include <utility>
 #include <vector>
 
 class OBJLoader
@@ -46,7 +47,22 @@ class OBJLoader
 
     std::vector<Vertex_idx> d_vertices;
 
-    typedef std::vector<std::string> StringList;
+    std::vector<Vertex> d_vertexData;   // interleaved, see vertex_data()
+
+    // the data of one chunk of the file, parsed independently
+    struct Chunk
+    {
+        enum { COORD = 1, TEX = 2, NORM = 4 };
+
+        std::vector<vec3> coordinates;
+        std::vector<vec3> normals;
+        std::vector<vec2> texCoords;
+        std::vector<Vertex_idx> vertices;
+        // vertices with relative (negative) indices, by position in
+        // vertices, and which of their indices (COORD | TEX | NORM)
+        std::vector<std::pair<size_t, unsigned>> relative;
+        bool error = false;
+    };
 
     public:
 
@@ -58,40 +74,30 @@ class OBJLoader
 
         /**
          * @brief vertex_data
-         * @return interleaved vertex data, see vertex.h
+         * @return interleaved vertex data, see vertex.h, three vertices
+         *  per triangle. It is built once while loading and lives as long
+         *  as the loader, bind it to a reference to avoid a copy.
          *
          * @note texCoord is only valid when hasTexCoords() returns
          *  true
          */
-        std::vector<Vertex> vertex_data() const;
+        std::vector<Vertex> const &vertex_data() const;
 
         unsigned numTriangles() const;
 
         bool hasTexCoords() const;
 
-        /**
-         * @brief unitize: scale mesh to fit in unitcube
-         *
-         * TODO: Implement this method yourself!
-         */
-        void unitize();
-
     private:
 
-        float getXLength(std::vector<Vertex> v, int N);
-        float getYLength(std::vector<Vertex> v, int N);
-        float getZLength(std::vector<Vertex> v, int N);
-        float getMaxLength(std::vector<Vertex> v, int N);        
+        /**
+         * @brief parseFile: memory maps the file, parses it in chunks of
+         *  whole lines on all cores and appends the chunks in file order
+         */
         void parseFile(std::string const &filename);
-        void parseLine(std::string const &line);
-        void parseVertex(StringList const &tokens);
-        void parseNormal(StringList const &tokens);
-        void parseTexCoord(StringList const &tokens);
-        void parseFace(StringList const &tokens);
-
-        StringList split(std::string const &str,
-                             char splitChar,
-                             bool keepEmpty = true);
+        static void parseChunk(char const *begin, char const *end,
+                               Chunk &chunk);
+        void merge(std::vector<Chunk> const &chunks);
+        void buildVertexData();
 
 };
 
@@ -0,0 +1,32 @@
+#include "packet.h"
+
+#include <limits>
+
+void PacketHit::reset()
+{
+    for (unsigned lane = 0; lane != MAX_PACKET_WIDTH; ++lane)
+    {
+        t[lane] = std::numeric_limits<float>::infinity();
+        nx[lane] = ny[lane] = nz[lane] = 0.0f;
+        id[lane] = -1;
+    }
+}
+
+PacketKernels const *selectPacketKernels(unsigned maxWidth)
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    PacketKernels const *kernels = nullptr;
+    // the getters of the wider kernels run their instructions, so only
+    // call them once the CPU is known to support them
+    if (maxWidth >= 16 && __builtin_cpu_supports("avx512f")
+        && (kernels = packetKernelsAVX512()))
+        return kernels;
+    if (maxWidth >= 8 && __builtin_cpu_supports("avx2")
+        && (kernels = packetKernelsAVX2()))
+        return kernels;
+    if (maxWidth >= 4 && (kernels = packetKernelsSSE()))
+        return kernels;
+#endif
+    return nullptr;
+}
@@ -0,0 +1,70 @@
+#ifndef PACKET_H_
+#define PACKET_H_
+
+// Packets of coherent rays (e.g. neighbouring primary rays) traced
+// together by SIMD kernels. Everything is single precision, stored as a
+// structure of arrays so that one vector register holds one component
+// of all rays. The scalar Scene::trace remains the reference path.
+
+#include "real.h"
+
+enum { MAX_PACKET_WIDTH = 16 };
+
+struct RayPacket
+{
+    alignas(64) float ox[MAX_PACKET_WIDTH];     // origins
+    alignas(64) float oy[MAX_PACKET_WIDTH];
+    alignas(64) float oz[MAX_PACKET_WIDTH];
+    alignas(64) float dx[MAX_PACKET_WIDTH];     // directions
+    alignas(64) float dy[MAX_PACKET_WIDTH];
+    alignas(64) float dz[MAX_PACKET_WIDTH];
+};
+
+// Closest hit found so far for each lane, id is -1 for no hit
+struct PacketHit
+{
+    alignas(64) float t[MAX_PACKET_WIDTH];
+    alignas(64) float nx[MAX_PACKET_WIDTH];     // normal at the hit
+    alignas(64) float ny[MAX_PACKET_WIDTH];
+    alignas(64) float nz[MAX_PACKET_WIDTH];
+    alignas(64) int id[MAX_PACKET_WIDTH];       // object that was hit
+
+    void reset();
+};
+
+// Intersection kernels for one instruction set, all lanes of the packet
+// are processed (width lanes). The shape kernels only update lanes where
+// the new hit is closer than hit.t, writing t, the normal and id.
+struct PacketKernels
+{
+    char const *name;
+    unsigned width;
+
+    // true if any lane hits the box before hit.t, tNear is the smallest
+    // entry distance over those lanes
+    bool (*box)(RayPacket const &packet, PacketHit const &hit,
+                Real const min[3], Real const max[3], float &tNear);
+
+    void (*sphere)(RayPacket const &packet, PacketHit &hit, int id,
+                   float const center[3], float radius);
+
+    void (*plane)(RayPacket const &packet, PacketHit &hit, int id,
+                  float const p0[3], float const normal[3]);
+
+    // the watertight test of shapes/watertight.h on the vertices
+    void (*triangle)(RayPacket const &packet, PacketHit &hit, int id,
+                     float const v0[3], float const v1[3],
+                     float const v2[3]);
+};
+
+// Kernels per instruction set, nullptr if not compiled in. Only call the
+// AVX2 and AVX-512 getters on a CPU that has them.
+PacketKernels const *packetKernelsSSE();
+PacketKernels const *packetKernelsAVX2();
+PacketKernels const *packetKernelsAVX512();
+
+// Widest kernels supported by this CPU with at most maxWidth lanes
+// (runtime dispatch), nullptr if there are none.
+PacketKernels const *selectPacketKernels(unsigned maxWidth = MAX_PACKET_WIDTH);
+
+#endif
@@ -0,0 +1,241 @@
+#include "pngwriter.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#else
+#include "lode/lodepng.h"
+#endif
+
+using namespace std;
+
+#ifdef HAVE_ZLIB
+
+namespace
+{
+    size_t const STRIP_SIZE = 1 << 18;  // filtered bytes deflated per task
+    size_t const WINDOW = 32768;        // deflate window, primes every strip
+
+    enum Filter: uint8_t
+    {
+        NONE,
+        SUB,
+        UP,
+        AVERAGE,
+        PAETH
+    };
+
+    inline uint8_t paeth(int left, int up, int upLeft)
+    {
+        int p = left + up - upLeft;
+        int pa = abs(p - left);
+        int pb = abs(p - up);
+        int pc = abs(p - upLeft);
+        if (pa <= pb && pa <= pc)
+            return left;
+        return pb <= pc ? up : upLeft;
+    }
+
+    // Row filtered by filter into out, prev is the row above (zeros for the
+    // first row). Returns the sum of the filtered bytes as signed values,
+    // the usual estimate of how well the row compresses. The filter is a
+    // template parameter so every filter's loop is compiled without the
+    // switch.
+    template <Filter filter>
+    unsigned filterRow(uint8_t const *row, uint8_t const *prev, size_t size,
+                       uint8_t *out)
+    {
+        unsigned const bpp = 3;
+        unsigned sum = 0;
+        for (size_t idx = 0; idx != size; ++idx)
+        {
+            int left = idx >= bpp ? row[idx - bpp] : 0;
+            int upLeft = idx >= bpp ? prev[idx - bpp] : 0;
+            uint8_t predicted = 0;
+            switch (filter)
+            {
+                case NONE:    predicted = 0; break;
+                case SUB:     predicted = left; break;
+                case UP:      predicted = prev[idx]; break;
+                case AVERAGE: predicted = (left + prev[idx]) / 2; break;
+                case PAETH:   predicted = paeth(left, prev[idx], upLeft); break;
+            }
+            out[idx] = row[idx] - predicted;
+            sum += abs(static_cast<int8_t>(out[idx]));
+        }
+        return sum;
+    }
+
+    // Every row prefixed by the filter type with the smallest sum, as
+    // libpng and lodepng choose them. Stored images are not filtered.
+    void filterRows(vector<uint8_t> const &rgb, unsigned width,
+                    unsigned height, int level, vector<uint8_t> &filtered)
+    {
+        size_t const rowSize = 3 * size_t(width);
+        filtered.resize((rowSize + 1) * height);
+        vector<uint8_t> const zeros(rowSize);
+
+#pragma omp parallel
+        {
+            vector<uint8_t> candidate(rowSize);
+#pragma omp for schedule(static)
+            for (int y = 0; y < static_cast<int>(height); ++y)
+            {
+                uint8_t const *row = &rgb[y * rowSize];
+                uint8_t const *prev = y == 0 ? zeros.data() : row - rowSize;
+                uint8_t *out = &filtered[y * (rowSize + 1)];
+                Filter best = NONE;
+                unsigned bestSum = filterRow<NONE>(row, prev, rowSize, out + 1);
+                for (Filter filter: {SUB, UP, AVERAGE, PAETH})
+                {
+                    if (level == PNG_STORE)
+                        break;
+                    unsigned sum = (filter == SUB ? filterRow<SUB>
+                                    : filter == UP ? filterRow<UP>
+                                    : filter == AVERAGE ? filterRow<AVERAGE>
+                                    : filterRow<PAETH>)(row, prev, rowSize,
+                                                        candidate.data());
+                    if (sum < bestSum)
+                    {
+                        best = filter;
+                        bestSum = sum;
+                        copy(candidate.begin(), candidate.end(), out + 1);
+                    }
+                }
+                out[0] = best;
+            }
+        }
+    }
+
+    void writeUInt32(ostream &out, uint32_t value)
+    {
+        char bytes[4] = {char(value >> 24), char(value >> 16),
+                         char(value >> 8), char(value)};
+        out.write(bytes, 4);
+    }
+
+    void writeChunk(ostream &out, char const *type, uint8_t const *data,
+                    size_t size)
+    {
+        writeUInt32(out, size);
+        out.write(type, 4);
+        out.write(reinterpret_cast<char const *>(data), size);
+        uLong crc = crc32(0, reinterpret_cast<Bytef const *>(type), 4);
+        if (size != 0)      // crc32 of a null buffer restarts at 0
+            crc = crc32(crc, data, size);
+        writeUInt32(out, crc);
+    }
+
+    // Raw deflate of one strip, ending on a byte boundary (sync flush) so
+    // the strips concatenate to one stream, the last one finishes it
+    bool deflateStrip(uint8_t const *begin, size_t size, size_t dictionary,
+                      bool last, int level, vector<uint8_t> &out)
+    {
+        z_stream stream = {};
+        if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_FILTERED)
+                != Z_OK)
+            return false;
+        if (dictionary != 0)
+            deflateSetDictionary(&stream, begin - dictionary, dictionary);
+
+        out.resize(deflateBound(&stream, size) + 16);
+        stream.next_in = const_cast<Bytef *>(begin);
+        stream.avail_in = size;
+        stream.next_out = out.data();
+        stream.avail_out = out.size();
+        int result = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+        bool done = last ? result == Z_STREAM_END
+                         : result == Z_OK && stream.avail_in == 0;
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+        return done;
+    }
+}
+
+void writePNG(string const &filename, vector<uint8_t> const &rgb,
+              unsigned width, unsigned height, int level)
+{
+    vector<uint8_t> filtered;
+    filterRows(rgb, width, height, level, filtered);
+
+    size_t numStrips = max<size_t>(1, (filtered.size() + STRIP_SIZE - 1)
+                                      / STRIP_SIZE);
+    vector<vector<uint8_t>> strips(numStrips);
+    bool failed = false;
+#pragma omp parallel for schedule(dynamic)
+    for (int strip = 0; strip < static_cast<int>(numStrips); ++strip)
+    {
+        size_t begin = strip * STRIP_SIZE;
+        size_t end = min(begin + STRIP_SIZE, filtered.size());
+        if (!deflateStrip(&filtered[begin], end - begin, min(begin, WINDOW),
+                          strip + 1 == static_cast<int>(numStrips), level,
+                          strips[strip]))
+            failed = true;
+    }
+    if (failed)
+        throw runtime_error("Compressing " + filename + " failed.");
+
+    // the zlib stream: header, the strips and the checksum of all data
+    uLong adler = adler32(0, nullptr, 0);
+    for (size_t strip = 0; strip != numStrips; ++strip)
+    {
+        size_t begin = strip * STRIP_SIZE;
+        size_t size = min(STRIP_SIZE, filtered.size() - begin);
+        adler = adler32_combine(adler, adler32(1, &filtered[begin], size),
+                                size);
+    }
+    unsigned flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+    uint8_t header[2] = {0x78, uint8_t(flevel << 6)};
+    header[1] += 31 - (header[0] * 256 + header[1]) % 31;
+    uint8_t checksum[4] = {uint8_t(adler >> 24), uint8_t(adler >> 16),
+                           uint8_t(adler >> 8), uint8_t(adler)};
+
+    ofstream out(filename, ios::binary);
+    if (!out)
+        throw runtime_error("Could not open " + filename + " for writing.");
+
+    out.write("\x89PNG\r\n\x1a\n", 8);
+    uint8_t ihdr[13] = {uint8_t(width >> 24), uint8_t(width >> 16),
+                        uint8_t(width >> 8), uint8_t(width),
+                        uint8_t(height >> 24), uint8_t(height >> 16),
+                        uint8_t(height >> 8), uint8_t(height),
+                        8,      // bits per channel
+                        2,      // RGB
+                        0, 0, 0};
+    writeChunk(out, "IHDR", ihdr, sizeof ihdr);
+    writeChunk(out, "IDAT", header, sizeof header);
+    for (vector<uint8_t> const &strip : strips)
+        writeChunk(out, "IDAT", strip.data(), strip.size());
+    writeChunk(out, "IDAT", checksum, sizeof checksum);
+    writeChunk(out, "IEND", nullptr, 0);
+
+    if (!out)
+        throw runtime_error("Writing " + filename + " failed.");
+}
+
+#else
+
+void writePNG(string const &filename, vector<uint8_t> const &rgb,
+              unsigned width, unsigned height, int level)
+{
+    lodepng::State state;
+    state.info_raw.colortype = LCT_RGB;
+    state.info_png.color.colortype = LCT_RGB;
+    state.encoder.auto_convert = 0;
+    if (level == PNG_STORE)
+        state.encoder.zlibsettings.btype = 0;
+
+    vector<unsigned char> png;
+    unsigned error = lodepng::encode(png, rgb, width, height, state);
+    if (!error)
+        error = lodepng::save_file(png, filename);
+    if (error)
+        throw runtime_error("Writing " + filename + " failed: "
+                            + lodepng_error_text(error));
+}
+
+#endif
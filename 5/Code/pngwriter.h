@@ -0,0 +1,25 @@
+#ifndef PNGWRITER_H_
+#define PNGWRITER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// zlib compression levels: 0 stores, 1 is fastest, 9 compresses best
+enum
+{
+    PNG_STORE = 0,
+    PNG_DEFAULT_COMPRESSION = 6
+};
+
+// Writes width x height pixels of 8 bit r, g, b (row by row) as an RGB
+// PNG. With zlib the rows are filtered and deflated in strips by all
+// threads, every strip primed with the end of the previous one, so the
+// file is about as small as a single threaded encoder's. Without zlib
+// (HAVE_ZLIB undefined) lodepng encodes the image on one thread.
+// Throws std::runtime_error if the file cannot be written.
+void writePNG(std::string const &filename, std::vector<uint8_t> const &rgb,
+              unsigned width, unsigned height,
+              int level = PNG_DEFAULT_COMPRESSION);
+
+#endif
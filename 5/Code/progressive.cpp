@@ -0,0 +1,25 @@
+#include "progressive.h"
+
+namespace
+{
+    // radical inverse of index in the given base
+    Real halton(unsigned index, unsigned base)
+    {
+        Real result = 0;
+        Real fraction = Real(1) / base;
+        for (; index != 0; index /= base, fraction /= base)
+            result += fraction * (index % base);
+        return result;
+    }
+}
+
+void samplePosition(unsigned index, Real &x, Real &y)
+{
+    if (index == 0)
+    {
+        x = y = 0.5;
+        return;
+    }
+    x = halton(index, 2);
+    y = halton(index, 3);
+}
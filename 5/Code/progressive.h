@@ -0,0 +1,42 @@
+#ifndef PROGRESSIVE_H_
+#define PROGRESSIVE_H_
+
+#include "real.h"
+
+#include <functional>
+
+class Image;
+
+// Progressive rendering (Scene::renderProgressive) delivers a usable image
+// early and improves it pass by pass: first one ray per 16 x 16 block of
+// pixels, then per 8 x 8 block and so on down to every pixel, after which
+// each pass adds one more sample to every pixel. Rendering stops after the
+// requested number of samples per pixel or once the time budget is spent.
+
+enum { PROGRESSIVE_COARSEST_STEP = 16 };    // pixel spacing of the first pass
+
+struct ProgressiveOptions
+{
+    double timeBudget = 0;      // seconds of rendering, 0: unlimited
+    unsigned samples = 0;       // samples per pixel, 0: SuperSamplingFactor^2
+};
+
+struct PassInfo
+{
+    unsigned pass;          // counting from 0
+    unsigned step;          // pixel spacing of a refinement pass, 1 for
+                            // the passes adding samples
+    unsigned samples;       // samples per pixel after the pass
+    bool complete;          // false: the budget ran out during the pass
+    double seconds;         // since rendering started
+};
+
+// called after every pass with the image so far
+typedef std::function<void(Image const &, PassInfo const &)> PassCallback;
+
+// Position within the pixel of sample 'index' (0, 1), (0, 1): the center
+// for sample 0, then the Halton sequence in bases 2 and 3, so any number
+// of samples covers the pixel evenly.
+void samplePosition(unsigned index, Real &x, Real &y);
+
+#endif
@@ -3,6 +3,9 @@
 
 #include "triple.h"
 
+#include <cmath>
+#include <limits>
+
 class Ray
 {
     public:
@@ -15,10 +18,35 @@ class Ray
             D(dir)
         {}
 
-        Point at(double t) const
+        Point at(Real t) const
         {
             return O + t * D;
         }
 };
 
+// Origin for a secondary ray leaving the surface where ray hits it at t,
+// on the side N points to, with t computed in arithmetic of machine
+// epsilon eps. The hit point O + tD is off by a few ulps of
+// the terms it is computed from, not of the result: a point near 0 found
+// from an origin at 1000 is off by ulps of 1000. The origin is moved along
+// N past that error bound (as in pbrt), so the offset follows the scene
+// scale and the precision instead of being a world space constant.
+inline Point offsetRayOrigin(Ray const &ray, Real t, Vector const &N,
+                             Real eps = std::numeric_limits<Real>::epsilon())
+{
+    // ulps of error allowed for, covering both the error in t and the
+    // error of O + tD
+    Real const ERROR_ULPS = 64;
+
+    Point p = ray.at(t);
+    Real offset = 0;
+    for (unsigned axis = 0; axis != 3; ++axis)
+    {
+        Real error = std::fabs(ray.O.data[axis])
+                     + std::fabs(t * ray.D.data[axis]);
+        offset += std::fabs(N.data[axis]) * ERROR_ULPS * eps * error;
+    }
+    return p + offset * N;
+}
+
 #endif
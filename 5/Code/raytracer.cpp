@@ -1,8 +1,10 @@
 #include "raytracer.h"
 
+#include "animation.h"
 #include "image.h"
 #include "light.h"
 #include "material.h"
+#include "scenecache.h"
 #include "triple.h"
 
 // =============================================================================
@@ -12,6 +14,8 @@
 #include "shapes/sphere.h"
 #include "shapes/triangle.h"
 #include "shapes/plane.h"
+#include "shapes/trianglemesh.h"
+#include "shapes/meshinstance.h"
 #include "objloader.h"
 
 // =============================================================================
@@ -20,51 +24,83 @@
 
 #include "json/json.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
 #include <exception>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <numeric>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;        // no std:: required
 using json = nlohmann::json;
 
-bool Raytracer::parseObjectNode(json const &node)
+Raytracer::Raytracer()
 {
-    ObjectPtr obj = nullptr;
-
 // =============================================================================
-// -- Determine type and parse object parametrers ------------------------------
+// -- Register your shapes here ------------------------------------------------
 // =============================================================================
 
-    if (node["type"] == "sphere")
+    registerShape("sphere", [](json const &node, Scene &scene) -> Object *
     {
         Point pos(node["position"]);
         double radius = node["radius"];
-        obj = ObjectPtr(new Sphere(pos, radius));
-    } else if (node["type"] == "triangle") {
+        // orientation of a texture: "rotation" is the axis through its poles
+        Vector axis(0, 1, 0);
+        if (node.count("rotation"))
+            axis = Vector(node["rotation"]);
+        double angle = node.value("angle", 0.0);
+        return scene.addObject<Sphere>(pos, radius, axis, angle);
+    });
+
+    registerShape("triangle", [](json const &node, Scene &scene) -> Object *
+    {
         json points = node["points"];
         Point pointA(points["a"]);
         Point pointB(points["b"]);
         Point pointC(points["c"]);
-        obj = ObjectPtr(new Triangle(pointA, pointB, pointC));
-    }
-    else if (node["type"] == "plane") {
+        return scene.addObject<Triangle>(pointA, pointB, pointC);
+    });
+
+    registerShape("plane", [](json const &node, Scene &scene) -> Object *
+    {
         Point p0(node["p0"]);
         Triple N(node["normal"]);
-        obj = ObjectPtr(new Plane(p0, N));
-    } else {
-            cerr << "Unknown object type: " << node["type"] << ".\n";
-    }
+        return scene.addObject<Plane>(p0, N);
+    });
 
 // =============================================================================
-// -- End of object reading ----------------------------------------------------
+// -- End of shape registration ------------------------------------------------
 // =============================================================================
+}
+
+void Raytracer::registerShape(string const &type, ShapeFactory const &factory)
+{
+    shapeFactories[type] = factory;
+}
 
+bool Raytracer::parseObjectNode(json const &node)
+{
+    string type = node.value("type", "");
+    auto factory = shapeFactories.find(type);
+    if (factory == shapeFactories.end())
+    {
+        cerr << "Unknown object type: " << node["type"] << ".\n";
+        return false;
+    }
+
+    Object *obj = factory->second(node, scene);
     if (!obj)
         return false;
 
-    // Parse material and add object to the scene
+    // Parse the material of the object added to the scene
     obj->material = parseMaterialNode(node["material"]);
-    scene.addObject(obj);
     return true;
 }
 
@@ -75,58 +111,140 @@ Light Raytracer::parseLightNode(json const &node) const
     return Light(pos, col);
 }
 
-Material Raytracer::parseMaterialNode(json const &node) const
+Material Raytracer::parseMaterialNode(json const &node)
 {
-    Color color(node["color"]);
+    // a textured material takes its color from the texture
+    Color color(1, 1, 1);
+    if (!node.count("texture"))
+        color = Color(node["color"]);
     double ka = node["ka"];
     double kd = node["kd"];
     double ks = node["ks"];
     double n  = node["n"];
-    return Material(color, ka, kd, ks, n);
+    Material material(color, ka, kd, ks, n);
+    if (node.count("texture"))
+        material.texture = loadTexture(sceneDir + node["texture"].get<string>());
+    return material;
+}
+
+int Raytracer::loadTexture(string const &filename)
+{
+    TexturePtr &texture = textures[filename];
+    if (!texture)
+    {
+        PhaseTimer timer(stats, "load textures");
+        texture = TexturePtr(new Texture(filename));
+    }
+
+    // the texture may be in the scene already, or be kept from a
+    // previous scene
+    vector<TexturePtr> const &current = scene.getTextures();
+    auto found = find(current.begin(), current.end(), texture);
+    if (found != current.end())
+        return found - current.begin();
+    return scene.addTexture(texture);
+}
+
+TriangleMeshPtr Raytracer::loadMesh(string const &filename)
+{
+    TriangleMeshPtr &mesh = meshes[filename];
+    if (mesh)
+        return mesh;
+
+    // the mesh is kept in the coordinates of the OBJ file, the instances
+    // place it in the scene
+    mesh = TriangleMeshPtr(new TriangleMesh);
+    {
+        PhaseTimer timer(stats, "load OBJ");
+        OBJLoader objLoader(filename);
+        vector<Vertex> const &vv = objLoader.vertex_data();
+
+        mesh->reserve(vv.size() / 3);
+        for (unsigned int i = 0; i < vv.size(); i += 3){
+            Point p[3];
+            for (unsigned int j = 0; j < 3; j++)
+                p[j] = Point(vv[i+j].x, vv[i+j].y, vv[i+j].z);
+            mesh->addTriangle(p[0], p[1], p[2]);
+        }
+    }
+    {
+        PhaseTimer timer(stats, "build BVH");
+        mesh->build();
+    }
+    return mesh;
 }
 
 bool Raytracer::readScene(string const &ifname)
 try
 {
+    if (isSceneCache(ifname))
+    {
+        {
+            PhaseTimer timer(stats, "load cache");
+            readSceneCache(ifname, scene);
+        }
+        cout << "Loaded " << scene.getNumObject() << " objects from the "
+             << "scene cache.\n";
+        PhaseTimer timer(stats, "build BVH");
+        scene.buildAccelerationStructure();
+        return true;
+    }
+
+    // textures are relative to the scene file
+    size_t slash = ifname.find_last_of('/');
+    sceneDir = slash == string::npos ? "" : ifname.substr(0, slash + 1);
+
     // Read and parse input json file
     ifstream infile(ifname);
     if (!infile) throw runtime_error("Could not open input file for reading.");
     json jsonscene;
-    infile >> jsonscene;
+    {
+        PhaseTimer timer(stats, "parse JSON");
+        infile >> jsonscene;
+    }
 
 // =============================================================================
 // -- Read your scene data in this section -------------------------------------
 // =============================================================================
 
-    Point eye(jsonscene["Eye"]);
-    scene.setEye(eye);
+    if (jsonscene.count("Camera"))
+        scene.setCamera(Camera(jsonscene["Camera"]));
+    else
+    {
+        Point eye(jsonscene["Eye"]);
+        scene.setEye(eye);
+    }
+
+    // Optional render settings
+    if (jsonscene.count("Shadows"))
+        scene.setShadows(jsonscene["Shadows"]);
+    if (jsonscene.count("MaxRecursionDepth"))
+        scene.setMaxRecursionDepth(jsonscene["MaxRecursionDepth"]);
+    if (jsonscene.count("LightAttenuation"))
+    {
+        // [constant, linear, quadratic]
+        json const &factors = jsonscene["LightAttenuation"];
+        Attenuation attenuation;
+        attenuation.constant = factors.at(0);
+        attenuation.linear = factors.at(1);
+        attenuation.quadratic = factors.at(2);
+        scene.setAttenuation(attenuation);
+    }
+    if (jsonscene.count("SuperSamplingFactor"))
+        scene.setSuperSampling(jsonscene["SuperSamplingFactor"]);
 
-    ObjectPtr obj = nullptr;
-    
     for (auto const &lightNode : jsonscene["Lights"])
         scene.addLight(parseLightNode(lightNode));
 
     unsigned objCount = 0;
 
+    // every model is loaded once, each entry is an instance of it
     for (auto const &meshNode : jsonscene["Meshes"]) {
-        const string s = meshNode["model"];
-        OBJLoader objLoader = OBJLoader(s);
-        objLoader.unitize();
-        vector<Vertex> vv = objLoader.vertex_data();
-        for (unsigned int i = 0; i < vv.size(); i += 3){
-            Point p[3];
-            Point translation(meshNode["translation"]);
-            double scale(meshNode["scale"]);
-            for (unsigned int j = 0; j < 3; j++){
-                p[j].x = vv[i+j].x * scale + translation.x;
-                p[j].y = vv[i+j].y * scale + translation.y;
-                p[j].z = vv[i+j].z * scale + translation.z;
-            }
-            Triangle *t = new Triangle(p[0], p[1], p[2]);
-            obj = ObjectPtr(t);
-            obj->material = parseMaterialNode(meshNode["material"]);
-            scene.addObject(obj);
-        }
+        TriangleMeshPtr mesh = loadMesh(meshNode["model"]);
+        placements.push_back(Placement(meshNode));
+        instances.push_back(scene.addObject<MeshInstance>(
+            mesh, placements.back().transform()));
+        instances.back()->material = parseMaterialNode(meshNode["material"]);
         ++objCount;
     }
 
@@ -136,6 +254,11 @@ try
 
     cout << "Parsed " << objCount << " objects.\n";
 
+    {
+        PhaseTimer timer(stats, "build BVH");
+        scene.buildAccelerationStructure();
+    }
+
 // =============================================================================
 // -- End of scene data reading ------------------------------------------------
 // =============================================================================
@@ -148,12 +271,362 @@ catch (exception const &ex)
     return false;
 }
 
-void Raytracer::renderToFile(string const &ofname)
+namespace
+{
+    // mkdir -p of the directory part of filename
+    void createParentDirectories(string const &filename)
+    {
+        for (size_t slash = filename.find('/', 1); slash != string::npos;
+             slash = filename.find('/', slash + 1))
+        {
+            string dir = filename.substr(0, slash);
+            if (mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST)
+                throw runtime_error("Could not create directory " + dir);
+        }
+    }
+}
+
+bool Raytracer::renderAnimation(string const &ifname,
+                                string const &ofpattern)
+try
 {
-    Image img(400, 400);
+    Animation animation(ifname);
+    string pattern = ofpattern.empty() ? animation.output() : ofpattern;
+    if (pattern.empty())    // anim.json: anim0000.png, anim0001.png, ...
+        pattern = ifname.substr(0, ifname.find_last_of('.')) + ".png";
+    createParentDirectories(frameName(pattern, 0));
+    if (!animation.sceneList() && !readScene(animation.sceneFile(0)))
+        return false;
+
+    auto start = chrono::steady_clock::now();
+    Image buffers[2];           // one is written while the other is traced
+    future<bool> writing;
+    RayCounters counters = RayCounters();
+    unsigned long long pixels = 0;
+    for (unsigned frame = 0; frame != animation.frames(); ++frame)
+    {
+        if (animation.sceneList())
+        {
+            scene.clear();
+            instances.clear();
+            placements.clear();
+            if (!readScene(animation.sceneFile(frame)))
+                return false;
+        }
+        else if (animation.apply(frame, scene, instances, placements))
+        {
+            PhaseTimer timer(stats, "refit BVH");
+            scene.refitAccelerationStructure();
+        }
+
+        Camera const &camera = scene.getCamera();
+        Image &img = buffers[frame % 2];
+        string ofname = frameName(pattern, frame);
+        Image::Format format = Image::isFloatFile(ofname) ? Image::FLOAT
+                                                          : Image::BYTE;
+        unsigned w = width ? width : camera.viewWidth;
+        unsigned h = height ? height : camera.viewHeight;
+        if (img.width() != w || img.height() != h || img.format() != format)
+            img = Image(w, h, format);
+        {
+            PhaseTimer timer(stats, "trace");
+            scene.render(img);
+        }
+        counters += scene.rayCounters();
+        pixels += img.size();
+
+        if (writing.valid())
+        {
+            PhaseTimer timer(stats, "write wait");
+            if (!writing.get())
+                return false;
+        }
+        cout << "Frame " << frame << ": " << ofname << '\n';
+        writing = async(launch::async, [this, &img, ofname]
+        {
+            return writeImage(img, ofname);
+        });
+    }
+    if (!writing.get())
+        return false;
+
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    cout << "Rendered " << animation.frames() << " frames in "
+         << elapsed.count() << " s ("
+         << animation.frames() * 3600 / elapsed.count()
+         << " frames per hour).\n";
+    stats.setCounters(counters);
+    stats.setPixels(pixels);
+    cout << "Statistics:\n";
+    stats.print(cout);
+    return true;
+}
+catch (exception const &ex)
+{
+    cerr << ex.what() << '\n';
+    return false;
+}
+
+bool Raytracer::compileScene(string const &ofname)
+try
+{
+    writeSceneCache(ofname, scene);
+    cout << "Wrote scene cache " << ofname << ".\n";
+    return true;
+}
+catch (exception const &ex)
+{
+    cerr << ex.what() << '\n';
+    return false;
+}
+
+void Raytracer::setUseBVH(bool enable)
+{
+    scene.setUseBVH(enable);
+}
+
+void Raytracer::setPacketWidth(unsigned maxWidth)
+{
+    PacketKernels const *kernels = nullptr;
+    if (maxWidth > 0)
+    {
+        kernels = selectPacketKernels(maxWidth);
+        if (kernels)
+            cout << "Tracing primary rays in packets of " << kernels->width
+                 << " (" << kernels->name << ").\n";
+        else
+            cout << "No packet kernels for this CPU, tracing scalar rays.\n";
+    }
+    scene.setPacketKernels(kernels);
+}
+
+void Raytracer::setWavefront(bool enable)
+{
+    scene.setWavefront(enable);
+}
+
+void Raytracer::setResolution(unsigned w, unsigned h)
+{
+    width = w;
+    height = h;
+}
+
+void Raytracer::setTiling(unsigned size, string const &order)
+{
+    scene.setTiling(size, parseTileOrder(order));
+}
+
+void Raytracer::setThreads(unsigned threads)
+{
+    scene.setThreads(threads);
+}
+
+void Raytracer::setTileStatsFile(string const &filename)
+{
+    tileStatsFile = filename;
+}
+
+void Raytracer::setWriteStats(bool enable)
+{
+    writeStats = enable;
+}
+
+void Raytracer::setLightSampling(LightSampling const &sampling)
+{
+    scene.setLightSampling(sampling);
+}
+
+void Raytracer::setAdaptiveSampling(AdaptiveOptions const &options)
+{
+    scene.setAdaptiveSampling(options);
+}
+
+void Raytracer::setSampleHeatmapFile(string const &filename)
+{
+    heatmapFile = filename;
+}
+
+void Raytracer::setCompression(int level)
+{
+    if (level < 0 || level > 9)
+        throw invalid_argument("compression level " + to_string(level));
+    compression = level;
+}
+
+void Raytracer::setProgressive(ProgressiveOptions const &options)
+{
+    progressive = true;
+    progressiveOptions = options;
+}
+
+Scene &Raytracer::getScene()
+{
+    return scene;
+}
+
+bool Raytracer::renderToFile(string const &ofname)
+{
+    Camera const &camera = scene.getCamera();
+    // stored as bytes unless written as floats
+    Image img(width ? width : camera.viewWidth,
+              height ? height : camera.viewHeight,
+              Image::isFloatFile(ofname) ? Image::FLOAT : Image::BYTE);
     cout << "Tracing...\n";
-    scene.render(img);
-    cout << "Writing image to " << ofname << "...\n";
-    img.write_png(ofname);
+    bool written = true;
+    if (progressive)
+    {
+        // the image file is replaced after every pass, the final image is
+        // the last pass
+        PhaseTimer timer(stats, "trace");
+        scene.renderProgressive(img, progressiveOptions,
+            [&](Image const &pass, PassInfo const &info)
+            {
+                cout << "Pass " << info.pass << ": ";
+                if (info.step > 1)
+                    cout << "1/" << info.step << " resolution";
+                else
+                    cout << info.samples << " samples per pixel";
+                cout << (info.complete ? "" : " (incomplete)") << " after "
+                     << info.seconds << " s\n";
+                written = writeImage(pass, ofname);
+            });
+    }
+    else
+    {
+        PhaseTimer timer(stats, "trace");
+        scene.setTileProgress(printTileProgress(cout, isatty(STDOUT_FILENO)));
+        scene.render(img);
+        scene.setTileProgress(TileProgress());
+    }
+    stats.setCounters(scene.rayCounters());
+    stats.setPixels(img.size());
+    if (!scene.sampleCounts().empty()
+        && !writeSampleHeatmap(img.width(), img.height()))
+        written = false;
+    reportTiles(scene.tileStats());
+    if (!progressive)
+    {
+        cout << "Writing image to " << ofname << "...\n";
+        PhaseTimer timer(stats, "write image");
+        written = writeImage(img, ofname) && written;
+    }
+    reportStats(ofname);
+    return written;
+}
+
+bool Raytracer::renderDistributed(string const &ofname,
+                                  DistributedOptions const &options)
+try
+{
+    Camera const &camera = scene.getCamera();
+    Image img(width ? width : camera.viewWidth,
+              height ? height : camera.viewHeight,
+              Image::isFloatFile(ofname) ? Image::FLOAT : Image::BYTE);
+    RayCounters counters = RayCounters();
+    vector<TileStats> tiles;
+    {
+        PhaseTimer timer(stats, "trace");
+        ::renderDistributed(scene, img, options, counters, tiles);
+    }
+    stats.setCounters(counters);
+    stats.setPixels(img.size());
+    reportTiles(tiles);
+    {
+        cout << "Writing image to " << ofname << "...\n";
+        PhaseTimer timer(stats, "write image");
+        if (!writeImage(img, ofname))
+            return false;
+    }
+    reportStats(ofname);
+    return true;
+}
+catch (exception const &ex)
+{
+    cerr << ex.what() << '\n';
+    return false;
+}
+
+bool Raytracer::renderAsWorker(string const &address)
+try
+{
+    unsigned rendered = ::renderAsWorker(address, scene);
+    cout << "Rendered " << rendered << " tiles.\n";
+    return true;
+}
+catch (exception const &ex)
+{
+    cerr << ex.what() << '\n';
+    return false;
+}
+
+// Writes to a temporary file first and renames it, so whoever watches the
+// image never reads a partly written one. The temporary file keeps the
+// extension, which selects the format.
+bool Raytracer::writeImage(Image const &img, string const &ofname) const
+try
+{
+    size_t dot = ofname.find_last_of('.');
+    if (dot == string::npos || ofname.find('/', dot) != string::npos)
+        dot = ofname.size();
+    string tmpName = ofname.substr(0, dot) + ".tmp" + ofname.substr(dot);
+    img.write(tmpName, compression);
+    if (rename(tmpName.c_str(), ofname.c_str()) != 0)
+    {
+        cerr << "Could not rename " << tmpName << " to " << ofname << '\n';
+        return false;
+    }
+    return true;
+}
+catch (exception const &ex)
+{
+    cerr << "Error: " << ex.what() << '\n';
+    return false;
+}
+
+void Raytracer::reportTiles(vector<TileStats> const &tiles) const
+{
+    printTileSummary(cout, tiles);
+    if (!tileStatsFile.empty())
+    {
+        ofstream statsFile(tileStatsFile);
+        writeTileStats(statsFile, tiles);
+    }
+}
+
+void Raytracer::reportStats(string const &ofname) const
+{
+    cout << "Statistics:\n";
+    stats.print(cout);
+    if (writeStats)
+    {
+        string statsName = ofname.substr(0, ofname.find_last_of('.')) + ".stats.json";
+        ofstream statsFile(statsName);
+        stats.writeJSON(statsFile);
+        cout << "Wrote statistics to " << statsName << ".\n";
+    }
     cout << "Done.\n";
 }
+
+// Prints the samples per pixel of adaptive sampling and, if requested,
+// writes them as a heat map: blue is the fewest samples, red the most
+bool Raytracer::writeSampleHeatmap(unsigned width, unsigned height) const
+{
+    vector<unsigned> const &samples = scene.sampleCounts();
+    unsigned maxCount = *max_element(samples.begin(), samples.end());
+    unsigned long long total = accumulate(samples.begin(), samples.end(),
+                                          0ULL);
+    cout << "Adaptive sampling: " << double(total) / samples.size()
+         << " samples per pixel on average, at most " << maxCount << ".\n";
+    if (heatmapFile.empty())
+        return true;
+
+    Image heatmap(width, height, Image::BYTE);
+    for (unsigned y = 0; y != height; ++y)
+        for (unsigned x = 0; x != width; ++x)
+            heatmap.put_pixel(x, y,
+                              heatColor(Real(samples[y * width + x]) / maxCount));
+    if (!writeImage(heatmap, heatmapFile))
+        return false;
+    cout << "Wrote sample heat map to " << heatmapFile << ".\n";
+    return true;
+}
@@ -1,31 +1,158 @@
 #ifndef RAYTRACER_H_
 #define RAYTRACER_H_
 
+#include "distributed.h"
+#include "pngwriter.h"
+#include "renderstats.h"
 #include "scene.h"
+#include "shapes/meshinstance.h"
 
+#include <functional>
+#include <map>
 #include <string>
 
 // Forward declerations
+class Image;
 class Light;
 class Material;
 
 #include "json/json_fwd.h"
 
+// Makes the object of a scene file's "Objects" entry, adding it to scene
+// (with Scene::addObject); the material is read by the caller. Returns
+// nullptr (or throws) if the entry is invalid.
+typedef std::function<Object *(nlohmann::json const &node, Scene &scene)>
+    ShapeFactory;
+
 class Raytracer
 {
     Scene scene;
+    std::map<std::string, ShapeFactory> shapeFactories;     // by "type"
+    RenderStats stats;
+    bool writeStats = false;
+    std::string tileStatsFile;
+    unsigned width = 0;     // output resolution, 0: the camera's viewSize
+    unsigned height = 0;
+    std::map<std::string, TriangleMeshPtr> meshes;  // by OBJ file name
+    std::map<std::string, TexturePtr> textures;     // by PNG file name
+    std::vector<MeshInstance *> instances;  // "Meshes", owned by scene
+    std::vector<Placement> placements;      // of the instances, as read
+    std::string sceneDir;   // of the scene file, textures are relative to it
+    bool progressive = false;
+    ProgressiveOptions progressiveOptions;
+    std::string heatmapFile;
+    int compression = PNG_DEFAULT_COMPRESSION;
 
     public:
 
+        Raytracer();
+
+        // objects of this "type" in scene files are made by factory (which
+        // replaces the one registered before). Shapes other than the
+        // built-in ones are intersected through Object's virtual functions
+        // (see ShapeKind) and cannot be written to a scene cache.
+        void registerShape(std::string const &type,
+                           ShapeFactory const &factory);
+
+        // a JSON scene or a scene cache written by compileScene
         bool readScene(std::string const &ifname);
-        void renderToFile(std::string const &ofname);
+
+        // false if the image could not be written
+        bool renderToFile(std::string const &ofname);
+
+        // Render the frames of an animation file (see animation.h) to
+        // files named by ofpattern (see frameName; empty: the animation's
+        // "Output", whose directory is created). Meshes, textures and the
+        // threads are kept between frames, moved instances are refitted
+        // instead of rebuilt, and a frame is written while the next one is
+        // traced. False as soon as a frame cannot be written.
+        bool renderAnimation(std::string const &ifname,
+                             std::string const &ofpattern);
+
+        // renderToFile with worker processes instead of the threads of
+        // this process (see distributed.h)
+        bool renderDistributed(std::string const &ofname,
+                               DistributedOptions const &options);
+
+        // render tiles for the coordinator at address (host:port) until
+        // it is done, instead of reading a scene
+        bool renderAsWorker(std::string const &address);
+
+        // write the scene read by readScene as a binary scene cache
+        bool compileScene(std::string const &ofname);
+
+        // fall back to testing all objects per ray (for verification)
+        void setUseBVH(bool enable);
+
+        // trace primary rays in SIMD packets of at most maxWidth rays,
+        // 0 selects the scalar path
+        void setPacketWidth(unsigned maxWidth);
+
+        // trace tiles bounce by bounce, sorting secondary rays for
+        // coherence (see wavefront.h)
+        void setWavefront(bool enable);
+
+        // render at this resolution instead of the camera's viewSize
+        void setResolution(unsigned w, unsigned h);
+
+        // tiles of size x size pixels in the given order ("scanline",
+        // "morton" or "hilbert") rendered by the given number of threads
+        void setTiling(unsigned size, std::string const &order);
+        void setThreads(unsigned threads);
+
+        // write the timing of every tile as CSV to this file
+        void setTileStatsFile(std::string const &filename);
+
+        // also write the statistics printed after rendering as JSON, next
+        // to the image (scene.png: scene.stats.json)
+        void setWriteStats(bool enable);
+
+        // render in passes of increasing quality (see progressive.h),
+        // writing the image after every pass
+        void setProgressive(ProgressiveOptions const &options);
+
+        // shade with lights from a light tree (see lighttree.h)
+        void setLightSampling(LightSampling const &sampling);
+
+        // sample pixels adaptively instead of on the SuperSamplingFactor
+        // grid (see adaptive.h)
+        void setAdaptiveSampling(AdaptiveOptions const &options);
+
+        // write the samples taken per pixel by adaptive sampling as a
+        // false color image to this file
+        void setSampleHeatmapFile(std::string const &filename);
+
+        // zlib level of PNG output: 0 stores, 1 is fastest, 9 smallest
+        void setCompression(int level);
+
+        // the scene as read by readScene (e.g. to render it repeatedly)
+        Scene &getScene();
 
     private:
 
         bool parseObjectNode(nlohmann::json const &node);
 
+        // the mesh of an OBJ file, loaded on first use
+        TriangleMeshPtr loadMesh(std::string const &filename);
+
         Light parseLightNode(nlohmann::json const &node) const;
-        Material parseMaterialNode(nlohmann::json const &node) const;
+        Material parseMaterialNode(nlohmann::json const &node);
+
+        // the scene's index of the texture in a PNG file, loaded on first
+        // use
+        int loadTexture(std::string const &filename);
+
+        // prints the error and returns false if the image is not written
+        bool writeImage(Image const &img, std::string const &ofname) const;
+
+        // print the tile summary and write the tile stats file
+        void reportTiles(std::vector<TileStats> const &tiles) const;
+
+        // print the statistics and write them as JSON if requested
+        void reportStats(std::string const &ofname) const;
+
+        // false if the heat map was requested and could not be written
+        bool writeSampleHeatmap(unsigned width, unsigned height) const;
 };
 
 #endif
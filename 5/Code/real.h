@@ -0,0 +1,13 @@
+#ifndef REAL_H_
+#define REAL_H_
+
+// Precision of the geometry and shading (vectors, rays, hits, shapes):
+// double, or float when built with SINGLE_PRECISION. Float halves the
+// size of all geometry and doubles the lanes per SIMD register.
+#ifdef SINGLE_PRECISION
+typedef float Real;
+#else
+typedef double Real;
+#endif
+
+#endif
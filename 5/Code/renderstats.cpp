@@ -0,0 +1,141 @@
+#include "renderstats.h"
+
+#include "json/json.h"
+
+#include <iomanip>
+#include <ostream>
+
+using namespace std;
+using json = nlohmann::json;
+
+unsigned long long RayCounters::totalRays() const
+{
+    unsigned long long total = 0;
+    for (unsigned type = 0; type != NUM_RAYS; ++type)
+        total += rays[type];
+    return total;
+}
+
+RayCounters &RayCounters::operator+=(RayCounters const &other)
+{
+    for (unsigned type = 0; type != NUM_RAYS; ++type)
+        rays[type] += other.rays[type];
+    for (unsigned type = 0; type != NUM_TESTS; ++type)
+        tests[type] += other.tests[type];
+    return *this;
+}
+
+char const *RayCounters::rayName(Ray type)
+{
+    static char const *const names[NUM_RAYS] =
+        {"primary", "shadow", "reflection"};
+    return names[type];
+}
+
+char const *RayCounters::testName(Test type)
+{
+    static char const *const names[NUM_TESTS] =
+        {"box", "sphere", "plane", "triangle", "mesh triangle", "other"};
+    return names[type];
+}
+
+void RenderStats::addPhase(string const &name, double seconds)
+{
+    for (auto &entry : d_phases)
+        if (entry.first == name)
+        {
+            entry.second += seconds;
+            return;
+        }
+    d_phases.push_back(make_pair(name, seconds));
+}
+
+double RenderStats::phase(string const &name) const
+{
+    for (auto const &entry : d_phases)
+        if (entry.first == name)
+            return entry.second;
+    return 0.0;
+}
+
+void RenderStats::setCounters(RayCounters const &counters)
+{
+    d_counters = counters;
+}
+
+void RenderStats::setPixels(unsigned long long pixels)
+{
+    d_pixels = pixels;
+}
+
+void RenderStats::print(ostream &os) const
+{
+    ios::fmtflags flags = os.flags();
+    streamsize precision = os.precision(3);
+    os << fixed;
+
+    double total = 0.0;
+    for (auto const &entry : d_phases)
+    {
+        os << "  " << left << setw(14) << entry.first << right
+           << setw(10) << entry.second << " s\n";
+        total += entry.second;
+    }
+    os << "  " << left << setw(14) << "total" << right
+       << setw(10) << total << " s\n";
+
+    os << "  rays:";
+    for (unsigned type = 0; type != RayCounters::NUM_RAYS; ++type)
+        os << ' ' << d_counters.rays[type] << ' '
+           << RayCounters::rayName(RayCounters::Ray(type));
+
+    double trace = phase("trace");
+    if (trace > 0)
+        os << " (" << d_counters.totalRays() / trace * 1e-6 << " Mrays/s)";
+    os << "\n  tests:";
+    for (unsigned type = 0; type != RayCounters::NUM_TESTS; ++type)
+        if (d_counters.tests[type] != 0)
+            os << ' ' << d_counters.tests[type] << ' '
+               << RayCounters::testName(RayCounters::Test(type));
+    os << '\n';
+
+    os.flags(flags);
+    os.precision(precision);
+}
+
+void RenderStats::writeJSON(ostream &os) const
+{
+    json phases = json::object();
+    for (auto const &entry : d_phases)
+        phases[entry.first] = entry.second;
+
+    json rays = json::object();
+    for (unsigned type = 0; type != RayCounters::NUM_RAYS; ++type)
+        rays[RayCounters::rayName(RayCounters::Ray(type))] = d_counters.rays[type];
+
+    json tests = json::object();
+    for (unsigned type = 0; type != RayCounters::NUM_TESTS; ++type)
+        tests[RayCounters::testName(RayCounters::Test(type))] = d_counters.tests[type];
+
+    double trace = phase("trace");
+    json stats;
+    stats["phases"] = phases;
+    stats["pixels"] = d_pixels;
+    stats["rays"] = rays;
+    stats["tests"] = tests;
+    stats["raysPerSecond"] = trace > 0 ? d_counters.totalRays() / trace : 0.0;
+    os << setw(4) << stats << '\n';
+}
+
+PhaseTimer::PhaseTimer(RenderStats &stats, string const &name)
+:
+    d_stats(stats),
+    d_name(name),
+    d_start(chrono::steady_clock::now())
+{}
+
+PhaseTimer::~PhaseTimer()
+{
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - d_start;
+    d_stats.addPhase(d_name, elapsed.count());
+}
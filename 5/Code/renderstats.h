@@ -0,0 +1,90 @@
+#ifndef RENDERSTATS_H_
+#define RENDERSTATS_H_
+
+#include <chrono>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Work done while rendering: rays cast by type and intersection tests by
+// type of primitive. Every thread counts in its own RayCounters (see
+// threadCounters()), the renderer adds them up per tile so counting
+// needs no synchronisation.
+struct RayCounters
+{
+    enum Ray
+    {
+        PRIMARY,
+        SHADOW,
+        REFLECTION,
+        NUM_RAYS
+    };
+
+    enum Test
+    {
+        BOX,                // BVH nodes
+        SPHERE,
+        PLANE,
+        TRIANGLE,
+        MESH_TRIANGLE,      // triangles of a TriangleMesh
+        OTHER,
+        NUM_TESTS
+    };
+
+    unsigned long long rays[NUM_RAYS];
+    unsigned long long tests[NUM_TESTS];
+
+    unsigned long long totalRays() const;
+    RayCounters &operator+=(RayCounters const &other);
+
+    static char const *rayName(Ray type);
+    static char const *testName(Test type);
+};
+
+// the counters of the calling thread
+inline RayCounters &threadCounters()
+{
+    static thread_local RayCounters counters;   // zero initialized
+    return counters;
+}
+
+// Wall time per phase of a run (parsing, loading, tracing, ...) and the
+// counters of the render, reported at the end of the run.
+class RenderStats
+{
+    std::vector<std::pair<std::string, double>> d_phases;  // in order
+    RayCounters d_counters = RayCounters();
+    unsigned long long d_pixels = 0;
+
+    public:
+        // adds to the time of an earlier phase with the same name
+        void addPhase(std::string const &name, double seconds);
+        double phase(std::string const &name) const;
+
+        void setCounters(RayCounters const &counters);
+        void setPixels(unsigned long long pixels);
+
+        // human readable summary
+        void print(std::ostream &os) const;
+
+        // the same as a JSON object
+        void writeJSON(std::ostream &os) const;
+};
+
+// Adds the time from construction to destruction to a phase
+class PhaseTimer
+{
+    RenderStats &d_stats;
+    std::string d_name;
+    std::chrono::steady_clock::time_point d_start;
+
+    public:
+        PhaseTimer(RenderStats &stats, std::string const &name);
+        ~PhaseTimer();
+
+        PhaseTimer(PhaseTimer const &) = delete;
+        PhaseTimer &operator=(PhaseTimer const &) = delete;
+};
+
+#endif
@@ -4,31 +4,247 @@
 #include "image.h"
 #include "material.h"
 #include "ray.h"
+#include "wavefront.h"
 
+#include "shapes/plane.h"
+#include "shapes/sphere.h"
+#include "shapes/triangle.h"
+
+#include <atomic>
 #include <cmath>
+#include <cstring>
 #include <limits>
+#include <mutex>
 
 using namespace std;
 
+namespace
+{
+    // visit(obj) with obj as its final class if it is a built in shape
+    template <typename Visitor>
+    inline auto dispatchShape(Object &obj, Visitor &&visit)
+        -> decltype(visit(obj))
+    {
+        switch (obj.kind)
+        {
+            case ShapeKind::SPHERE:
+                return visit(static_cast<Sphere &>(obj));
+            case ShapeKind::PLANE:
+                return visit(static_cast<Plane &>(obj));
+            case ShapeKind::TRIANGLE:
+                return visit(static_cast<Triangle &>(obj));
+            default:
+                return visit(obj);
+        }
+    }
+
+    // Object::occluded for the built in shapes, without its virtual call
+    // of distance
+    template <typename Shape>
+    inline bool blocksRay(Shape &shape, Ray const &ray, Real tMax)
+    {
+        unsigned prim;
+        return shape.distance(ray, prim) < tMax;
+    }
+
+    inline bool blocksRay(Object &obj, Ray const &ray, Real tMax)
+    {
+        return obj.occluded(ray, tMax);
+    }
+
+    inline uint32_t mix(uint32_t bits)
+    {
+        bits ^= bits >> 16;
+        bits *= 0x7feb352d;
+        bits ^= bits >> 15;
+        bits *= 0x846ca68b;
+        return bits ^ bits >> 16;
+    }
+
+    // a random number per hit point, so the lights picked do not depend
+    // on the thread or the order of rendering
+    uint32_t hashPoint(Point const &p)
+    {
+        uint32_t hash = 0;
+        for (unsigned axis = 0; axis != 3; ++axis)
+        {
+            float value = p.data[axis];
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof bits);
+            hash = mix(hash ^ bits);
+        }
+        return hash;
+    }
+}
+
 Color Scene::trace(Ray const &ray)
+{
+    Hit min_hit(numeric_limits<Real>::infinity(), Vector());
+    Object const *obj = closestHit(ray, min_hit);
+
+    // No hit? Return background color.
+    if (!obj) return Color(0.0, 0.0, 0.0);
+
+    return radiance(*obj, ray, min_hit);
+}
+
+// The objects only report the distance to their closest hit, the normal
+// is computed once for the object that ends up closest
+Object const *Scene::closestHit(Ray const &ray, Hit &min_hit)
 {
     // Find hit object and distance
-    Hit min_hit(numeric_limits<double>::infinity(), Vector());
-    ObjectPtr obj = nullptr;
-    for (unsigned idx = 0; idx != objects.size(); ++idx)
+    Real tMin = numeric_limits<Real>::infinity();
+    Object *obj = nullptr;
+    unsigned objPrim = 0;
+    auto intersect = [&](unsigned idx, Real &tMax)
     {
-        Hit hit(objects[idx]->intersect(ray));
-        if (hit.t < min_hit.t)
+        unsigned prim;
+        Real t = dispatchShape(*objects[idx], [&](auto &shape)
+        {
+            return shape.distance(ray, prim);
+        });
+        if (t < tMax)
         {
-            min_hit = hit;
+            tMax = tMin = t;
             obj = objects[idx];
+            objPrim = prim;
+        }
+        return false;   // we want the closest hit, keep going
+    };
+
+    if (useBVH)
+    {
+        for (unsigned idx : unbounded)
+            intersect(idx, tMin);
+        bvh.traverse(ray, tMin, [&](unsigned prim, Real &tMax)
+        {
+            return intersect(bounded[prim], tMax);
+        });
+    }
+    else
+    {
+        for (unsigned idx = 0; idx != objects.size(); ++idx)
+            intersect(idx, tMin);
+    }
+
+    if (obj)
+        min_hit = Hit(tMin, obj->normal(ray, tMin, objPrim));
+    else
+        min_hit = Hit(tMin, Vector());
+    return obj;
+}
+
+bool Scene::occluded(Ray const &ray, Real tMax)
+{
+    auto blocks = [&](unsigned idx, Real &)
+    {
+        return dispatchShape(*objects[idx], [&](auto &shape)
+        {
+            return blocksRay(shape, ray, tMax);
+        });
+    };
+
+    if (!useBVH)
+    {
+        for (unsigned idx = 0; idx != objects.size(); ++idx)
+            if (blocks(idx, tMax))
+                return true;
+        return false;
+    }
+
+    for (unsigned idx : unbounded)
+        if (blocks(idx, tMax))
+            return true;
+
+    // the traversal stops at the first blocking object
+    bool hit = false;
+    bvh.traverse(ray, tMax, [&](unsigned prim, Real &t)
+    {
+        hit = blocks(bounded[prim], t);
+        return hit;
+    });
+    return hit;
+}
+
+// Follows the path of mirror reflections iteratively: instead of
+// recursing into trace() every bounce continues with the reflected ray,
+// its contribution weighted by the product of the ks values so far.
+Color Scene::radiance(Object const &obj, Ray const &ray, Hit const &hit)
+{
+    Color color;
+    Color weight(1.0, 1.0, 1.0);
+
+    Object const *current = &obj;
+    Ray path(ray);
+    Hit pathHit(hit);
+    Real length = 0;        // of the path so far, the footprint grows with it
+    for (unsigned depth = 0; ; ++depth)
+    {
+        length += pathHit.t;
+        Real footprint = camera.pixelSpread() / superSampling * length;
+        color += weight * shade(*current, path, pathHit, footprint);
+
+        Real ks = current->material.ks;
+        if (depth >= maxRecursionDepth || ks <= 0.0)
+            break;
+
+        Vector N = pathHit.N;
+        Vector D = path.D;
+        Point origin = offsetRayOrigin(path, pathHit.t, faceForward(N, D),
+                                       pathHit.eps);
+        path = Ray(origin, D - 2 * D.dot(N) * N);
+        weight *= ks;
+        ++threadCounters().rays[RayCounters::REFLECTION];
+
+        current = closestHit(path, pathHit);
+        if (!current)
+            break;          // the background is black
+    }
+    return color;
+}
+
+template <typename Visitor>
+void Scene::forEachLight(Point const &p, Vector const &N, Visitor &&visit)
+{
+    if (lightSampling.samples != 0)
+    {
+        // lights picked by the tree, weighted by the inverse probability
+        uint32_t seed = hashPoint(p);
+        for (unsigned sample = 0; sample != lightSampling.samples; ++sample)
+        {
+            Real u = (mix(seed + sample) >> 8) * Real(1.0 / (1 << 24));
+            unsigned idx;
+            Real pdf;
+            if (lightTree.sample(p, N, attenuation, lightSampling.threshold,
+                                 u, idx, pdf))
+                visit(lights[idx], 1 / (lightSampling.samples * pdf));
         }
     }
+    else if (lightSampling.threshold > 0)
+        lightTree.cull(p, N, attenuation, lightSampling.threshold,
+                       [&](unsigned idx)
+                       {
+                           visit(lights[idx], 1);
+                       });
+    else
+        for (Light const &light : lights)
+            visit(light, 1);
+}
 
-    // No hit? Return background color.
-    if (!obj) return Color(0.0, 0.0, 0.0);
+void Scene::addPhong(Light const &light, Real weight, Vector const &L,
+                     Real distance, Vector const &N, Vector const &V,
+                     Real exponent, Color &ID, Color &IS) const
+{
+    Color intensity = weight * attenuation(distance) * light.color;
+    ID += max(Real(0), L.dot(N)) * intensity;
+    Vector R = 2 * (L.dot(N)) * N - L;
+    IS += pow(max(Real(0), R.dot(V)), exponent) * intensity;
+}
 
-    Material material = obj->material;          //the hit objects material
+Color Scene::shade(Object const &obj, Ray const &ray, Hit const &min_hit,
+                   Real footprint)
+{
+    Material material = obj.material;          //the hit objects material
     Point hit = ray.at(min_hit.t);                 //the hit point
     Vector N = min_hit.N;                          //the normal at hit point
     Vector V = -ray.D;                             //the view vector
@@ -52,55 +268,761 @@ Color Scene::trace(Ray const &ray)
      ****************************************************/
     Color IA, ID, IS;
     IA = ID = IS = Color();
-    Vector L, R;
-    for (unsigned int i = 0 ; i < lights.size() ; i++) {
-        L = (lights[i]->position - hit).normalized();
-        ID += max(0.0, L.dot(N)) * lights[i]->color;
-        R = 2 * (L.dot(N)) * N - L;
-        IS += pow(max(0.0, R.dot(V)), material.n) * lights[i]->color;
-    }
-    IA = material.color * material.ka;
-    ID = ID * material.color * material.kd;
+    Vector L;
+    Point shadowOrigin = offsetRayOrigin(ray, min_hit.t,
+                                         faceForward(N, ray.D), min_hit.eps);
+    RayCounters &rayCount = threadCounters();
+    forEachLight(hit, N, [&](Light const &light, Real weight)
+    {
+        L = light.position - hit;
+        Real distance = L.length();
+        L /= distance;
+
+        // skip lights that are blocked by another object
+        if (shadows)
+        {
+            ++rayCount.rays[RayCounters::SHADOW];
+            if (occluded(Ray(shadowOrigin, L), distance))
+                return;
+        }
+        addPhong(light, weight, L, distance, N, V, material.n, ID, IS);
+    });
+    Color color = surfaceColor(obj, hit, footprint);
+    IA = color * material.ka;
+    ID = ID * color * material.kd;
     IS = IS * material.ks;
 
     //double ID = max(0.0, N.dot(V)) * material.kd;
-    Color color = IA + ID + IS; 
-    return color;
+    return IA + ID + IS;
+}
+
+Color Scene::surfaceColor(Object const &obj, Point const &hit,
+                          Real footprint) const
+{
+    Material const &material = obj.material;
+    Real u, v, size;
+    if (material.texture < 0
+        || !obj.textureCoordinates(hit, u, v, size))
+        return material.color;
+    return textures[material.texture]->sample(u, v, footprint / size);
+}
+
+void Scene::prepareLights()
+{
+    if (lightTreeValid)
+        return;
+    lightTree.build(lights);
+    lightTreeValid = true;
+}
+
+Vector Scene::faceForward(Vector const &N, Vector const &D)
+{
+    return N.dot(D) < 0 ? N : -N;
+}
+
+void Scene::tracePacket(RayPacket const &packet, PacketHit &hit)
+{
+    PacketKernels const &kernels = *packetKernels;
+    if (useBVH)
+    {
+        for (unsigned idx : unbounded)
+            objects[idx]->intersectPacket(packet, hit, idx, kernels);
+        bvh.traversePacket(packet, hit, kernels, [&](unsigned prim)
+        {
+            unsigned idx = bounded[prim];
+            objects[idx]->intersectPacket(packet, hit, idx, kernels);
+        });
+    }
+    else
+    {
+        for (unsigned idx = 0; idx != objects.size(); ++idx)
+            objects[idx]->intersectPacket(packet, hit, idx, kernels);
+    }
 }
 
 void Scene::render(Image &img)
 {
-    unsigned w = img.width();
-    unsigned h = img.height();
-#pragma omp parallel for
-    for (unsigned y = 0; y < h; ++y)
+    render(img, img.width(), img.height(),
+           Tile{0, 0, img.width(), img.height()});
+}
+
+void Scene::render(Image &img, unsigned width, unsigned height,
+                   Tile const &region)
+{
+    prepareLights();
+    camera.setResolution(width, height);
+    frameWidth = width;
+    frameHeight = height;
+    window = region;
+
+    // tiles in frame coordinates, renderTile* store at (x, y) - window
+    vector<Tile> tiles = makeTiles(img.width(), img.height(),
+                                   tileSize, tileOrder);
+    for (Tile &tile : tiles)
+    {
+        tile.x0 += window.x0;
+        tile.x1 += window.x0;
+        tile.y0 += window.y0;
+        tile.y1 += window.y0;
+    }
+    stats.clear();
+    counters = RayCounters();
+    samples.assign(adaptive ? img.size() : 0, 0);
+    renderTiles(tiles, [&](Tile const &tile)
+    {
+        if (adaptive)
+            renderTileAdaptive(img, tile);
+        else if (wavefront)
+            renderTileWavefront(img, tile);
+        else if (packetKernels)
+            renderTilePackets(img, tile);
+        else
+            renderTile(img, tile);
+    });
+}
+
+void Scene::renderProgressive(Image &img, ProgressiveOptions const &options,
+                              PassCallback const &onPass)
+{
+    auto start = chrono::steady_clock::now();
+    auto deadline = options.timeBudget > 0
+        ? start + chrono::duration_cast<chrono::steady_clock::duration>(
+                      chrono::duration<double>(options.timeBudget))
+        : chrono::steady_clock::time_point::max();
+
+    prepareLights();
+    camera.setResolution(img.width(), img.height());
+    frameWidth = img.width();
+    frameHeight = img.height();
+    window = Tile{0, 0, img.width(), img.height()};
+    Progress progress{vector<Color>(img.size()),
+                      vector<unsigned>(img.size(), 0)};
+
+    // tiles hold whole blocks of the coarsest pass
+    unsigned step = PROGRESSIVE_COARSEST_STEP;
+    unsigned size = (max(tileSize, 1U) + step - 1) / step * step;
+    vector<Tile> tiles = makeTiles(img.width(), img.height(), size, tileOrder);
+    stats.clear();
+    counters = RayCounters();
+
+    unsigned samples = options.samples ? options.samples
+                                       : superSampling * superSampling;
+    unsigned done = 0;          // samples per pixel so far
+    for (unsigned pass = 0; ; ++pass)
+    {
+        // the first pass always completes, so there is an image to show
+        bool complete = renderTiles(tiles, [&](Tile const &tile)
+        {
+            if (step != 0)
+                refineTile(img, tile, step, progress);
+            else
+                sampleTile(img, tile, done, progress);
+        }, pass == 0 ? chrono::steady_clock::time_point::max() : deadline);
+
+        if (step <= 1 && complete)
+            ++done;             // every pixel has one more sample
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        onPass(img, PassInfo{pass, max(step, 1U), max(done, 1U), complete,
+                             elapsed.count()});
+
+        step /= 2;              // 0: full resolution, add samples
+        if (!complete || chrono::steady_clock::now() >= deadline
+            || done >= samples)
+            break;
+    }
+}
+
+// Traces the pixels on the grid of spacing step that no earlier (coarser)
+// pass traced, each one filling the step x step block it starts until a
+// later pass traces the other pixels of the block
+void Scene::refineTile(Image &img, Tile const &tile, unsigned step,
+                       Progress &progress)
+{
+    for (unsigned y = tile.y0; y < tile.y1; y += step)
+        for (unsigned x = tile.x0; x < tile.x1; x += step)
+        {
+            unsigned idx = y * img.width() + x;
+            if (progress.count[idx] != 0)
+                continue;
+
+            ++threadCounters().rays[RayCounters::PRIMARY];
+            Color col = trace(camera.ray(x + 0.5, y + 0.5));
+            progress.sum[idx] = col;
+            for (unsigned by = y; by < min(y + step, tile.y1); ++by)
+                for (unsigned bx = x; bx < min(x + step, tile.x1); ++bx)
+                    if (progress.count[by * img.width() + bx] == 0)
+                        img.put_pixel(bx, by, col);
+            progress.count[idx] = 1;
+        }
+}
+
+// Adds sample number 'sample' (see samplePosition) to every pixel
+void Scene::sampleTile(Image &img, Tile const &tile, unsigned sample,
+                       Progress &progress)
+{
+    Real dx, dy;
+    samplePosition(sample, dx, dy);
+    for (unsigned y = tile.y0; y < tile.y1; ++y)
+        for (unsigned x = tile.x0; x < tile.x1; ++x)
+        {
+            unsigned idx = y * img.width() + x;
+            ++threadCounters().rays[RayCounters::PRIMARY];
+            progress.sum[idx] += trace(camera.ray(x + dx, y + dy));
+            ++progress.count[idx];
+            Color col = progress.sum[idx] / progress.count[idx];
+            img.put_pixel(x, y, col);
+        }
+}
+
+// Runs the tiles on the thread pool, adding their timings to stats and
+// their rays to counters. Tiles not started by the deadline are skipped,
+// returns whether all tiles were rendered.
+bool Scene::renderTiles(vector<Tile> const &tiles,
+                        function<void(Tile const &)> const &renderTile,
+                        chrono::steady_clock::time_point deadline)
+{
+    if (!pool || (numThreads != 0 && pool->size() != numThreads))
+        pool.reset(new ThreadPool(numThreads));
+
+    // each worker adds the counts of its tiles to its own entry
+    vector<RayCounters> workerCounters(pool->size(), RayCounters());
+    size_t first = stats.size();
+    stats.resize(first + tiles.size(), TileStats());
+    atomic<bool> skipped(false);
+    mutex progressMutex;
+    unsigned finished = 0;
+    auto reportProgress = [&]()
+    {
+        if (!tileProgress)
+            return;
+        lock_guard<mutex> lock(progressMutex);
+        tileProgress(++finished, tiles.size());
+    };
+
+    pool->run(tiles.size(), [&](unsigned task, unsigned worker)
+    {
+        auto start = chrono::steady_clock::now();
+        if (start >= deadline)
+        {
+            skipped = true;
+            stats[first + task] = TileStats{tiles[task], worker, 0.0};
+            reportProgress();
+            return;
+        }
+        RayCounters &local = threadCounters();
+        local = RayCounters();
+
+        renderTile(tiles[task]);
+
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        stats[first + task] = TileStats{tiles[task], worker, elapsed.count()};
+        workerCounters[worker] += local;
+        reportProgress();
+    });
+
+    for (RayCounters const &entry : workerCounters)
+        counters += entry;
+    return !skipped;
+}
+
+// Every pixel is sampled on a regular superSampling x superSampling grid
+void Scene::renderTile(Image &img, Tile const &tile)
+{
+    unsigned n = superSampling;
+    Real invSamples = 1.0 / (n * n);
+    for (unsigned y = tile.y0; y < tile.y1; ++y)
+    {
+        for (unsigned x = tile.x0; x < tile.x1; ++x)
+        {
+            Color col;
+            for (unsigned sy = 0; sy != n; ++sy)
+                for (unsigned sx = 0; sx != n; ++sx)
+                {
+                    Ray ray(camera.ray(x + (sx + 0.5) / n, y + (sy + 0.5) / n));
+                    ++threadCounters().rays[RayCounters::PRIMARY];
+                    col += trace(ray);
+                }
+            if (n > 1)
+                col *= invSamples;
+            img.put_pixel(x - window.x0, y - window.y0, col);
+        }
+    }
+}
+
+// Adaptive sampling (see adaptive.h). The first batch of samples is also
+// taken for the pixels bordering the tile, to compare the pixels at the
+// edge of the tile with their neighbours; their estimates are the same
+// as those of the tile that owns them, the samples are deterministic.
+void Scene::renderTileAdaptive(Image &img, Tile const &tile)
+{
+    AdaptiveOptions const &options = adaptiveOptions;
+    unsigned batch = max(options.minSamples, 1U);
+    RayCounters &rayCount = threadCounters();
+    auto addSamples = [&](PixelEstimate &estimate, unsigned x, unsigned y,
+                          unsigned count)
+    {
+        count = min(count, options.maxSamples);
+        while (estimate.count() < count)
+        {
+            Real dx, dy;
+            samplePosition(estimate.count(), dx, dy);
+            ++rayCount.rays[RayCounters::PRIMARY];
+            estimate.add(trace(camera.ray(x + dx, y + dy)));
+        }
+    };
+
+    // the tile with a border of one pixel, clipped to the image
+    unsigned x0 = tile.x0 > 0 ? tile.x0 - 1 : 0;
+    unsigned y0 = tile.y0 > 0 ? tile.y0 - 1 : 0;
+    unsigned x1 = min(tile.x1 + 1, frameWidth);
+    unsigned y1 = min(tile.y1 + 1, frameHeight);
+    unsigned stride = x1 - x0;
+    vector<PixelEstimate> estimates(stride * (y1 - y0));
+    for (unsigned y = y0; y != y1; ++y)
+        for (unsigned x = x0; x != x1; ++x)
+            addSamples(estimates[(y - y0) * stride + x - x0], x, y, batch);
+
+    for (unsigned y = tile.y0; y != tile.y1; ++y)
+        for (unsigned x = tile.x0; x != tile.x1; ++x)
+        {
+            unsigned idx = (y - y0) * stride + x - x0;
+            PixelEstimate estimate = estimates[idx];
+            Real contrast = 0;
+            if (x > x0)
+                contrast = max(contrast, estimate.contrast(estimates[idx - 1]));
+            if (x + 1 < x1)
+                contrast = max(contrast, estimate.contrast(estimates[idx + 1]));
+            if (y > y0)
+                contrast = max(contrast,
+                               estimate.contrast(estimates[idx - stride]));
+            if (y + 1 < y1)
+                contrast = max(contrast,
+                               estimate.contrast(estimates[idx + stride]));
+            if (contrast > options.contrast)
+                addSamples(estimate, x, y, options.edgeSamples);
+
+            while (estimate.count() < options.maxSamples
+                   && estimate.error() > options.threshold)
+                addSamples(estimate, x, y, estimate.count() + batch);
+
+            unsigned ix = x - window.x0;
+            unsigned iy = y - window.y0;
+            img.put_pixel(ix, iy, estimate.mean());
+            samples[iy * img.width() + ix] = estimate.count();
+        }
+}
+
+// Primary rays of horizontal runs of pixels are traced as one packet (per
+// sample position), shading is done per ray on the packet hits
+void Scene::renderTilePackets(Image &img, Tile const &tile)
+{
+    unsigned width = packetKernels->width;
+    unsigned n = superSampling;
+    Real invSamples = 1.0 / (n * n);
+    Point const &eye = camera.eye;
+    RayPacket packet;
+    PacketHit hit;
+    Vector dirs[MAX_PACKET_WIDTH];
+    Color cols[MAX_PACKET_WIDTH];
+    for (unsigned y = tile.y0; y < tile.y1; ++y)
+    {
+        for (unsigned x0 = tile.x0; x0 < tile.x1; x0 += width)
+        {
+            unsigned lanes = min(width, tile.x1 - x0);
+            for (unsigned lane = 0; lane != lanes; ++lane)
+                cols[lane] = Color();
+
+            for (unsigned sy = 0; sy != n; ++sy)
+                for (unsigned sx = 0; sx != n; ++sx)
+                {
+                    // lanes past the tile edge duplicate its last pixel
+                    for (unsigned lane = 0; lane != width; ++lane)
+                    {
+                        unsigned x = x0 + min(lane, lanes - 1);
+                        dirs[lane] = camera.ray(x + (sx + 0.5) / n,
+                                                y + (sy + 0.5) / n).D;
+                        packet.ox[lane] = eye.x;
+                        packet.oy[lane] = eye.y;
+                        packet.oz[lane] = eye.z;
+                        packet.dx[lane] = dirs[lane].x;
+                        packet.dy[lane] = dirs[lane].y;
+                        packet.dz[lane] = dirs[lane].z;
+                    }
+
+                    hit.reset();
+                    tracePacket(packet, hit);
+                    threadCounters().rays[RayCounters::PRIMARY] += lanes;
+
+                    for (unsigned lane = 0; lane != lanes; ++lane)
+                        if (hit.id[lane] >= 0)
+                        {
+                            Hit laneHit(hit.t[lane], Vector(hit.nx[lane],
+                                                            hit.ny[lane],
+                                                            hit.nz[lane]),
+                                        numeric_limits<float>::epsilon());
+                            cols[lane] += radiance(*objects[hit.id[lane]],
+                                                   Ray(eye, dirs[lane]), laneHit);
+                        }
+                }
+
+            for (unsigned lane = 0; lane != lanes; ++lane)
+            {
+                Color col = cols[lane];
+                if (n > 1)
+                    col *= invSamples;
+                img.put_pixel(x0 + lane - window.x0, y - window.y0, col);
+            }
+        }
+    }
+}
+
+// Wavefront integrator (see wavefront.h): every sample of the tile is a
+// path, the paths advance one bounce at a time. The shadow rays of a
+// bounce are traced before any hit is shaded, and their results are
+// applied in the order shade() applies them, so the image is the same as
+// that of renderTile.
+void Scene::renderTileWavefront(Image &img, Tile const &tile)
+{
+    struct Path
+    {
+        unsigned sample;        // index in colors
+        Color weight;           // product of the ks values so far
+        Real length;
+    };
+
+    // light that reaches a hit unless the shadow ray is blocked
+    struct ShadowTest
+    {
+        unsigned path;
+        Light const *light;
+        Real weight;
+        Real distance;
+    };
+
+    unsigned n = superSampling;
+    Real invSamples = 1.0 / (n * n);
+    RayCounters &rayCount = threadCounters();
+
+    // the samples in the order renderTile traces them
+    vector<Color> colors((tile.x1 - tile.x0) * (tile.y1 - tile.y0) * n * n);
+    vector<Ray> rays;
+    vector<Path> paths;
+    rays.reserve(colors.size());
+    paths.reserve(colors.size());
+    for (unsigned y = tile.y0; y < tile.y1; ++y)
+        for (unsigned x = tile.x0; x < tile.x1; ++x)
+            for (unsigned sy = 0; sy != n; ++sy)
+                for (unsigned sx = 0; sx != n; ++sx)
+                {
+                    paths.push_back(Path{unsigned(paths.size()),
+                                         Color(1.0, 1.0, 1.0), 0});
+                    rays.push_back(camera.ray(x + (sx + 0.5) / n,
+                                              y + (sy + 0.5) / n));
+                }
+    rayCount.rays[RayCounters::PRIMARY] += rays.size();
+
+    vector<Object const *> objs;
+    vector<Hit> hits;
+    vector<Color> ID, IS;
+    vector<Ray> shadowRays;
+    vector<ShadowTest> shadowTests;
+    vector<char> blocked;
+    vector<unsigned> order;
+    for (unsigned depth = 0; !rays.empty(); ++depth)
+    {
+        // primary rays are coherent in pixel order already
+        if (depth == 0)
+        {
+            order.resize(rays.size());
+            for (unsigned idx = 0; idx != rays.size(); ++idx)
+                order[idx] = idx;
+        }
+        else
+            coherentOrder(rays, order);
+        objs.assign(rays.size(), nullptr);
+        hits.assign(rays.size(), Hit(0, Vector()));
+        for (unsigned idx : order)
+            objs[idx] = closestHit(rays[idx], hits[idx]);
+
+        // the lights of every hit, tested for shadows all together
+        ID.assign(rays.size(), Color());
+        IS.assign(rays.size(), Color());
+        shadowRays.clear();
+        shadowTests.clear();
+        for (unsigned idx = 0; idx != rays.size(); ++idx)
+        {
+            if (!objs[idx])
+                continue;
+            Ray const &ray = rays[idx];
+            Hit const &hit = hits[idx];
+            Point p = ray.at(hit.t);
+            Point shadowOrigin = offsetRayOrigin(ray, hit.t,
+                                                 faceForward(hit.N, ray.D),
+                                                 hit.eps);
+            forEachLight(p, hit.N, [&](Light const &light, Real weight)
+            {
+                Vector L = light.position - p;
+                Real distance = L.length();
+                L /= distance;
+                if (shadows)
+                {
+                    shadowRays.push_back(Ray(shadowOrigin, L));
+                    shadowTests.push_back(ShadowTest{idx, &light, weight,
+                                                     distance});
+                }
+                else
+                    addPhong(light, weight, L, distance, hit.N, -ray.D,
+                             objs[idx]->material.n, ID[idx], IS[idx]);
+            });
+        }
+
+        coherentOrder(shadowRays, order);
+        blocked.assign(shadowRays.size(), 0);
+        for (unsigned idx : order)
+            blocked[idx] = occluded(shadowRays[idx],
+                                    shadowTests[idx].distance);
+        rayCount.rays[RayCounters::SHADOW] += shadowRays.size();
+        for (unsigned idx = 0; idx != shadowRays.size(); ++idx)
+        {
+            if (blocked[idx])
+                continue;
+            ShadowTest const &test = shadowTests[idx];
+            unsigned path = test.path;
+            addPhong(*test.light, test.weight, shadowRays[idx].D,
+                     test.distance, hits[path].N, -rays[path].D,
+                     objs[path]->material.n, ID[path], IS[path]);
+        }
+
+        // shade, the reflected rays form the next wavefront
+        unsigned next = 0;
+        for (unsigned idx = 0; idx != rays.size(); ++idx)
+        {
+            Object const *obj = objs[idx];
+            if (!obj)
+                continue;       // the background is black
+            Ray ray = rays[idx];
+            Hit const &hit = hits[idx];
+            Path path = paths[idx];
+            Material const &material = obj->material;
+
+            path.length += hit.t;
+            Real footprint = camera.pixelSpread() / superSampling
+                             * path.length;
+            Color color = surfaceColor(*obj, ray.at(hit.t), footprint);
+            colors[path.sample] += path.weight
+                                   * (color * material.ka
+                                      + ID[idx] * color * material.kd
+                                      + IS[idx] * material.ks);
+
+            if (depth >= maxRecursionDepth || material.ks <= 0.0)
+                continue;
+            Vector N = hit.N;
+            Vector D = ray.D;
+            Point origin = offsetRayOrigin(ray, hit.t, faceForward(N, D),
+                                           hit.eps);
+            path.weight *= material.ks;
+            rays[next] = Ray(origin, D - 2 * D.dot(N) * N);
+            paths[next] = path;
+            ++next;
+        }
+        rays.erase(rays.begin() + next, rays.end());
+        paths.erase(paths.begin() + next, paths.end());
+        rayCount.rays[RayCounters::REFLECTION] += next;
+    }
+
+    unsigned sample = 0;
+    for (unsigned y = tile.y0; y < tile.y1; ++y)
+        for (unsigned x = tile.x0; x < tile.x1; ++x)
+        {
+            Color col;
+            for (unsigned s = 0; s != n * n; ++s)
+                col += colors[sample++];
+            if (n > 1)
+                col *= invSamples;
+            img.put_pixel(x - window.x0, y - window.y0, col);
+        }
+}
+
+void Scene::buildAccelerationStructure()
+{
+    bounded.clear();
+    unbounded.clear();
+
+    vector<AABB> boxes;
+    for (unsigned idx = 0; idx != objects.size(); ++idx)
     {
-        for (unsigned x = 0; x < w; ++x)
+        AABB box = objects[idx]->boundingBox();
+        if (box.isEmpty())
+            continue;       // nothing to hit, and no centroid for the SAH
+        if (box.isBounded())
         {
-            Point pixel(x + 0.5, h - 1 - y + 0.5, 0);
-            Ray ray(eye, (pixel - eye).normalized());
-            Color col = trace(ray);
-            col.clamp();
-            img(x, y) = col;
+            bounded.push_back(idx);
+            boxes.push_back(box);
         }
+        else
+            unbounded.push_back(idx);
     }
+
+    bvh.build(boxes);
+}
+
+void Scene::refitAccelerationStructure()
+{
+    vector<AABB> boxes;
+    boxes.reserve(bounded.size());
+    for (unsigned idx : bounded)
+        boxes.push_back(objects[idx]->boundingBox());
+    bvh.refit(boxes);
+}
+
+void Scene::clear()
+{
+    objects.clear();
+    arena.clear();
+    lights.clear();
+    lightTreeValid = false;
+    textures.clear();
+    attenuation = Attenuation();
+    camera = Camera::fromEye(Point(200, 200, 1000));
+    bvh = BVH();
+    bounded.clear();
+    unbounded.clear();
+    shadows = false;
+    maxRecursionDepth = 0;
+    superSampling = 1;
 }
 
 // --- Misc functions ----------------------------------------------------------
 
-void Scene::addObject(ObjectPtr obj)
+unsigned Scene::addTexture(TexturePtr const &texture)
 {
-    objects.push_back(obj);
+    textures.push_back(texture);
+    return textures.size() - 1;
 }
 
 void Scene::addLight(Light const &light)
 {
-    lights.push_back(LightPtr(new Light(light)));
+    lights.push_back(light);
+    lightTreeValid = false;
+}
+
+void Scene::setLight(unsigned idx, Light const &light)
+{
+    lights.at(idx) = light;
+    lightTreeValid = false;
+}
+
+void Scene::setUseBVH(bool enable)
+{
+    useBVH = enable;
+}
+
+void Scene::setPacketKernels(PacketKernels const *kernels)
+{
+    packetKernels = kernels;
+}
+
+void Scene::setWavefront(bool enable)
+{
+    wavefront = enable;
+}
+
+void Scene::setTiling(unsigned size, TileOrder order)
+{
+    tileSize = size;
+    tileOrder = order;
+}
+
+void Scene::setThreads(unsigned threads)
+{
+    numThreads = threads;
+}
+
+void Scene::setTileProgress(TileProgress const &progress)
+{
+    tileProgress = progress;
+}
+
+void Scene::setShadows(bool enable)
+{
+    shadows = enable;
+}
+
+void Scene::setAttenuation(Attenuation const &falloff)
+{
+    attenuation = falloff;
+}
+
+Attenuation const &Scene::getAttenuation() const
+{
+    return attenuation;
+}
+
+void Scene::setLightSampling(LightSampling const &sampling)
+{
+    lightSampling = sampling;
+}
+
+void Scene::setMaxRecursionDepth(unsigned depth)
+{
+    maxRecursionDepth = depth;
+}
+
+void Scene::setSuperSampling(unsigned factor)
+{
+    superSampling = max(1U, factor);
+}
+
+void Scene::setAdaptiveSampling(AdaptiveOptions const &options)
+{
+    adaptive = true;
+    adaptiveOptions = options;
+    adaptiveOptions.maxSamples = max(options.maxSamples, 1U);
+}
+
+bool Scene::getShadows() const
+{
+    return shadows;
+}
+
+unsigned Scene::getMaxRecursionDepth() const
+{
+    return maxRecursionDepth;
+}
+
+unsigned Scene::getSuperSampling() const
+{
+    return superSampling;
+}
+
+vector<TileStats> const &Scene::tileStats() const
+{
+    return stats;
+}
+
+RayCounters const &Scene::rayCounters() const
+{
+    return counters;
+}
+
+vector<unsigned> const &Scene::sampleCounts() const
+{
+    return samples;
 }
 
 void Scene::setEye(Triple const &position)
 {
-    eye = position;
+    camera = Camera::fromEye(position);
+}
+
+void Scene::setCamera(Camera const &cam)
+{
+    camera = cam;
+}
+
+Camera const &Scene::getCamera() const
+{
+    return camera;
 }
 
 unsigned Scene::getNumObject()
@@ -112,3 +1034,18 @@ unsigned Scene::getNumLights()
 {
     return lights.size();
 }
+
+vector<Object *> const &Scene::getObjects() const
+{
+    return objects;
+}
+
+vector<Light> const &Scene::getLights() const
+{
+    return lights;
+}
+
+vector<TexturePtr> const &Scene::getTextures() const
+{
+    return textures;
+}
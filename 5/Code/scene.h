@@ -1,10 +1,25 @@
 #ifndef SCENE_H_
 #define SCENE_H_
 
+#include "adaptive.h"
+#include "arena.h"
+#include "bvh.h"
+#include "camera.h"
 #include "light.h"
+#include "lighttree.h"
 #include "object.h"
+#include "packet.h"
+#include "progressive.h"
+#include "renderstats.h"
+#include "texture.h"
+#include "threadpool.h"
+#include "tiles.h"
 #include "triple.h"
 
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <utility>
 #include <vector>
 
 // Forward declerations
@@ -13,25 +28,209 @@ class Image;
 
 class Scene
 {
-    std::vector<ObjectPtr> objects;
-    std::vector<LightPtr> lights;   // no ptr needed, but kept for consistency
-    Point eye;
+    Arena arena;                        // owns the objects
+    std::vector<Object *> objects;
+    std::vector<Light> lights;
+    std::vector<TexturePtr> textures;   // indexed by Material::texture
+    Attenuation attenuation;
+    LightTree lightTree;
+    bool lightTreeValid = false;        // rebuilt when lights change
+    LightSampling lightSampling;
+    Camera camera = Camera::fromEye(Point(200, 200, 1000));
+
+    BVH bvh;                            // over the bounded objects
+    std::vector<unsigned> bounded;      // BVH primitive -> objects index
+    std::vector<unsigned> unbounded;    // objects tested linearly (planes)
+    bool useBVH = true;
+    PacketKernels const *packetKernels = nullptr;   // null: scalar tracing
+    bool wavefront = false;             // trace tiles bounce by bounce
+
+    unsigned tileSize = 16;
+    TileOrder tileOrder = TileOrder::HILBERT;
+    unsigned numThreads = 0;                // 0: all hardware threads
+    std::unique_ptr<ThreadPool> pool;       // created by the first render
+    std::vector<TileStats> stats;           // of the last render
+    TileProgress tileProgress;              // may be empty
+    Tile window = Tile();                   // frame pixels held by the image
+    unsigned frameWidth = 0;                // of the whole image rendered
+    unsigned frameHeight = 0;
+    RayCounters counters = RayCounters();   // of the last render
+
+    bool shadows = false;
+    unsigned maxRecursionDepth = 0;         // reflection bounces
+    unsigned superSampling = 1;             // N x N samples per pixel
+    bool adaptive = false;                  // adaptive instead of N x N
+    AdaptiveOptions adaptiveOptions;
+    std::vector<unsigned> samples;          // per pixel, last adaptive render
 
     public:
 
         // trace a ray into the scene and return the color
         Color trace(Ray const &ray);
 
+        // closest object along the ray (nullptr if none) and its hit
+        Object const *closestHit(Ray const &ray, Hit &hit);
+
+        // any hit query: is there an object along the ray before tMax
+        bool occluded(Ray const &ray, Real tMax);
+
+        // closest hit along a packet of rays (one SIMD kernel width)
+        void tracePacket(RayPacket const &packet, PacketHit &hit);
+
         // render the scene to the given image
         void render(Image &img);
 
+        // render the pixels in region of a width x height image to img,
+        // which has the size of the region (a tile of a distributed
+        // render). The pixels are the same as those of a whole render.
+        void render(Image &img, unsigned width, unsigned height,
+                    Tile const &region);
+
+        // render in passes of increasing quality (see progressive.h),
+        // calling onPass with the image after each pass. Always uses the
+        // scalar path: the passes trace scattered rays, not packets.
+        void renderProgressive(Image &img, ProgressiveOptions const &options,
+                               PassCallback const &onPass);
+
+
+        // constructs a T (an Object) from args, owned by the scene until
+        // it is cleared or destroyed
+        template <typename T, typename... Args>
+        T *addObject(Args &&...args);
 
-        void addObject(ObjectPtr obj);
         void addLight(Light const &light);
+        void setLight(unsigned idx, Light const &light);
+
+        // returns the index for Material::texture
+        unsigned addTexture(TexturePtr const &texture);
+
         void setEye(Triple const &position);
+        void setCamera(Camera const &cam);
+        Camera const &getCamera() const;
+
+        // (re)build the acceleration structure, call after the scene
+        // is loaded and before rendering. Objects with an empty bounding box
+        // (nothing to hit) are left out.
+        void buildAccelerationStructure();
+
+        // update the acceleration structure to moved objects, call after
+        // changing objects (e.g. MeshInstance::setToWorld) that stay bounded
+        void refitAccelerationStructure();
+
+        // remove all objects, lights and textures and reset the scene
+        // settings and camera, e.g. to read the next scene
+        void clear();
+
+        // false: test every object for every ray (for verification)
+        void setUseBVH(bool enable);
+
+        // trace primary rays in packets with these kernels, nullptr
+        // selects the scalar reference path
+        void setPacketKernels(PacketKernels const *kernels);
+
+        // trace every tile as a wavefront (see wavefront.h) instead of
+        // path by path, in place of packets
+        void setWavefront(bool enable);
+
+        // the image is rendered in size x size tiles, in the given order
+        void setTiling(unsigned size, TileOrder order);
+        void setThreads(unsigned threads);
+
+        // called as the tiles of a render finish (empty: not called)
+        void setTileProgress(TileProgress const &progress);
+
+        void setAttenuation(Attenuation const &falloff);
+        Attenuation const &getAttenuation() const;
+
+        // shade hits with lights picked from a light tree (see lighttree.h)
+        void setLightSampling(LightSampling const &sampling);
+
+        void setShadows(bool enable);
+        void setMaxRecursionDepth(unsigned depth);
+        void setSuperSampling(unsigned factor);
+        // sample every pixel adaptively (scalar rays), instead of on the
+        // SuperSamplingFactor grid
+        void setAdaptiveSampling(AdaptiveOptions const &options);
+
+        bool getShadows() const;
+        unsigned getMaxRecursionDepth() const;
+        unsigned getSuperSampling() const;
+
+        // timing per tile of the last render
+        std::vector<TileStats> const &tileStats() const;
+
+        // rays and intersection tests of the last render
+        RayCounters const &rayCounters() const;
+
+        // samples taken per pixel (row by row) by the last adaptive render
+        std::vector<unsigned> const &sampleCounts() const;
 
         unsigned getNumObject();
         unsigned getNumLights();
+        std::vector<Object *> const &getObjects() const;
+        std::vector<Light> const &getLights() const;
+        std::vector<TexturePtr> const &getTextures() const;
+
+    private:
+        // color of the hit of ray with obj, including reflections
+        Color radiance(Object const &obj, Ray const &ray, Hit const &hit);
+
+        // local illumination (Phong) at the hit of ray with obj, a pixel
+        // covers footprint world units there
+        Color shade(Object const &obj, Ray const &ray, Hit const &min_hit,
+                    Real footprint);
+
+        // calls visit(light, weight) for the lights that shade a hit at p
+        // with normal N: every light, or the ones the light tree picks
+        template <typename Visitor>
+        void forEachLight(Point const &p, Vector const &N, Visitor &&visit);
+
+        // adds the Phong diffuse and specular light of light, scaled by
+        // weight, from direction L at distance to ID and IS (before the
+        // material's color, kd and ks)
+        void addPhong(Light const &light, Real weight, Vector const &L,
+                      Real distance, Vector const &N, Vector const &V,
+                      Real exponent, Color &ID, Color &IS) const;
+
+        // the material color, or its texture at the hit
+        Color surfaceColor(Object const &obj, Point const &hit,
+                           Real footprint) const;
+
+        // the light tree is built before rendering if the lights changed
+        void prepareLights();
+
+        // N flipped to the side the ray with direction D comes from
+        static Vector faceForward(Vector const &N, Vector const &D);
+
+        void renderTile(Image &img, Tile const &tile);
+        void renderTilePackets(Image &img, Tile const &tile);
+        void renderTileAdaptive(Image &img, Tile const &tile);
+        void renderTileWavefront(Image &img, Tile const &tile);
+
+        bool renderTiles(std::vector<Tile> const &tiles,
+                         std::function<void(Tile const &)> const &renderTile,
+                         std::chrono::steady_clock::time_point deadline
+                             = std::chrono::steady_clock::time_point::max());
+
+        // accumulated samples of a progressive render, per pixel
+        struct Progress
+        {
+            std::vector<Color> sum;
+            std::vector<unsigned> count;
+        };
+
+        void refineTile(Image &img, Tile const &tile, unsigned step,
+                        Progress &progress);
+        void sampleTile(Image &img, Tile const &tile, unsigned sample,
+                        Progress &progress);
 };
 
+template <typename T, typename... Args>
+T *Scene::addObject(Args &&...args)
+{
+    T *obj = arena.create<T>(std::forward<Args>(args)...);
+    objects.push_back(obj);
+    return obj;
+}
+
 #endif
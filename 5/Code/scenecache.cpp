@@ -0,0 +1,236 @@
+#include "scenecache.h"
+
+#include "blob.h"
+#include "mappedfile.h"
+
+#include "shapes/meshinstance.h"
+#include "shapes/plane.h"
+#include "shapes/sphere.h"
+#include "shapes/triangle.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+    char const MAGIC[8] = {'R', 'A', 'Y', 'S', 'C', 'N', 'E', '\n'};
+    uint32_t const VERSION = 3;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t realSize;          // sizeof(Real)
+        uint32_t meshScalarSize;    // sizeof(MeshReal)
+        uint32_t vectorSize;        // sizeof(Triple), differs when padded
+
+        static Header current()
+        {
+            Header header;
+            memcpy(header.magic, MAGIC, sizeof MAGIC);
+            header.version = VERSION;
+            header.realSize = sizeof(Real);
+            header.meshScalarSize = sizeof(MeshReal);
+            header.vectorSize = sizeof(Triple);
+            return header;
+        }
+    };
+
+    enum ObjectType: uint32_t
+    {
+        SPHERE,
+        PLANE,
+        TRIANGLE,
+        MESH_INSTANCE
+    };
+
+    void writeObject(BlobWriter &out, Object const &obj,
+                     map<TriangleMesh const *, uint32_t> const &meshIndex)
+    {
+        if (auto sphere = dynamic_cast<Sphere const *>(&obj))
+        {
+            out.write(SPHERE);
+            out.write(sphere->position);
+            out.write(sphere->r);
+            out.write(sphere->axis);
+            out.write(sphere->angle);
+        }
+        else if (auto plane = dynamic_cast<Plane const *>(&obj))
+        {
+            out.write(PLANE);
+            out.write(plane->p0);
+            out.write(plane->N);
+        }
+        else if (auto triangle = dynamic_cast<Triangle const *>(&obj))
+        {
+            out.write(TRIANGLE);
+            out.write(triangle->v0);
+            out.write(triangle->v1);
+            out.write(triangle->v2);
+        }
+        else if (auto instance = dynamic_cast<MeshInstance const *>(&obj))
+        {
+            out.write(MESH_INSTANCE);
+            out.write(meshIndex.at(instance->mesh().get()));
+            out.write(instance->toWorld());
+        }
+        else
+            throw runtime_error("scene cache: unsupported object type");
+        out.write(obj.material);
+    }
+
+    // adds the object to scene
+    void readObject(BlobReader &in, vector<TriangleMeshPtr> const &meshes,
+                    size_t numTextures, Scene &scene)
+    {
+        Object *obj;
+        switch (in.read<uint32_t>())
+        {
+            case SPHERE:
+            {
+                Point position = in.read<Point>();
+                Real r = in.read<Real>();
+                Vector axis = in.read<Vector>();
+                obj = scene.addObject<Sphere>(position, r, axis,
+                                              in.read<Real>());
+                break;
+            }
+            case PLANE:
+            {
+                Point p0 = in.read<Point>();
+                obj = scene.addObject<Plane>(p0, in.read<Vector>());
+                break;
+            }
+            case TRIANGLE:
+            {
+                Point v0 = in.read<Point>();
+                Point v1 = in.read<Point>();
+                obj = scene.addObject<Triangle>(v0, v1, in.read<Point>());
+                break;
+            }
+            case MESH_INSTANCE:
+            {
+                uint32_t mesh = in.read<uint32_t>();
+                if (mesh >= meshes.size())
+                    throw runtime_error("scene cache: invalid mesh index");
+                obj = scene.addObject<MeshInstance>(meshes[mesh],
+                                                    in.read<Transform>());
+                break;
+            }
+            default:
+                throw runtime_error("scene cache: invalid object type");
+        }
+        obj->material = in.read<Material>();
+        if (obj->material.texture >= static_cast<int>(numTextures))
+            throw runtime_error("scene cache: invalid texture index");
+    }
+}
+
+bool isSceneCache(string const &filename)
+{
+    ifstream in(filename, ios::binary);
+    char magic[sizeof MAGIC];
+    return in.read(magic, sizeof magic)
+           && memcmp(magic, MAGIC, sizeof MAGIC) == 0;
+}
+
+void writeSceneCache(string const &filename, Scene const &scene)
+{
+    ofstream file(filename, ios::binary);
+    if (!file)
+        throw runtime_error("Could not open " + filename + " for writing.");
+    BlobWriter out(file);
+
+    out.write(Header::current());
+    out.write(scene.getCamera());
+    out.write<uint32_t>(scene.getShadows());
+    out.write<uint32_t>(scene.getMaxRecursionDepth());
+    out.write<uint32_t>(scene.getSuperSampling());
+
+    out.write(scene.getAttenuation());
+    out.write<uint32_t>(scene.getLights().size());
+    for (Light const &light : scene.getLights())
+    {
+        out.write(light.position);
+        out.write(light.color);
+    }
+
+    // every mesh once, however many instances share it
+    map<TriangleMesh const *, uint32_t> meshIndex;
+    vector<TriangleMesh const *> meshes;
+    for (Object const *obj : scene.getObjects())
+        if (auto instance = dynamic_cast<MeshInstance const *>(obj))
+            if (meshIndex.emplace(instance->mesh().get(), meshes.size()).second)
+                meshes.push_back(instance->mesh().get());
+
+    out.write<uint32_t>(meshes.size());
+    for (TriangleMesh const *mesh : meshes)
+        mesh->write(out);
+
+    out.write<uint32_t>(scene.getTextures().size());
+    for (TexturePtr const &texture : scene.getTextures())
+        texture->write(out);
+
+    out.write<uint32_t>(scene.getObjects().size());
+    for (Object const *obj : scene.getObjects())
+        writeObject(out, *obj, meshIndex);
+
+    if (!file)
+        throw runtime_error("Writing " + filename + " failed.");
+}
+
+void readSceneCache(string const &filename, Scene &scene)
+{
+    MappedFile file(filename);
+    BlobReader in(file.begin(), file.end());
+
+    Header header = in.read<Header>();
+    Header expected = Header::current();
+    if (memcmp(header.magic, MAGIC, sizeof MAGIC) != 0)
+        throw runtime_error(filename + " is not a scene cache");
+    if (header.version != expected.version
+        || header.realSize != expected.realSize
+        || header.meshScalarSize != expected.meshScalarSize
+        || header.vectorSize != expected.vectorSize)
+        throw runtime_error(filename + " was compiled by another version or "
+                            "precision of the ray tracer, compile it again");
+
+    Camera camera = scene.getCamera();
+    in.read(camera);
+    scene.setCamera(camera);
+    scene.setShadows(in.read<uint32_t>());
+    scene.setMaxRecursionDepth(in.read<uint32_t>());
+    scene.setSuperSampling(in.read<uint32_t>());
+
+    scene.setAttenuation(in.read<Attenuation>());
+    uint32_t numLights = in.read<uint32_t>();
+    for (uint32_t idx = 0; idx != numLights; ++idx)
+    {
+        Point position = in.read<Point>();
+        scene.addLight(Light(position, in.read<Color>()));
+    }
+
+    vector<TriangleMeshPtr> meshes(in.read<uint32_t>());
+    for (TriangleMeshPtr &mesh : meshes)
+    {
+        mesh = TriangleMeshPtr(new TriangleMesh);
+        mesh->read(in);
+    }
+
+    uint32_t numTextures = in.read<uint32_t>();
+    for (uint32_t idx = 0; idx != numTextures; ++idx)
+    {
+        shared_ptr<Texture> texture(new Texture);
+        texture->read(in);
+        scene.addTexture(texture);
+    }
+
+    uint32_t numObjects = in.read<uint32_t>();
+    for (uint32_t idx = 0; idx != numObjects; ++idx)
+        readObject(in, meshes, numTextures, scene);
+}
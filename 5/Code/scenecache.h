@@ -0,0 +1,27 @@
+#ifndef SCENECACHE_H_
+#define SCENECACHE_H_
+
+#include "scene.h"
+
+#include <string>
+
+// Binary scene cache ("ray --compile-scene"): the settings, camera,
+// lights, objects and materials of a loaded scene, plus the triangles and
+// built BVH of every mesh, stored as flat arrays. Loading it maps the file
+// and copies the arrays out, nothing is parsed or rebuilt except the
+// scene's top level BVH over the objects.
+//
+// The cache is tied to this build: it stores raw Real, mesh and vector
+// data, so a build with other precision or padding options (or another
+// cache version) refuses it and the scene has to be compiled again.
+
+// whether the file starts with the scene cache signature
+bool isSceneCache(std::string const &filename);
+
+// throws if the scene contains an object type the cache does not know
+void writeSceneCache(std::string const &filename, Scene const &scene);
+
+// adds the cached scene to scene, throws on a corrupt or foreign cache
+void readSceneCache(std::string const &filename, Scene &scene);
+
+#endif
@@ -6,12 +6,19 @@ Hit Example::intersect(Ray const &ray)
 {
     /* Your intersect calculation goes here */
 
-    double t = 0 /* = ... */;
+    Real t = 0 /* = ... */;
     Vector N /* = ... */;
 
     return Hit(t, N);
 }
 
+AABB Example::boundingBox() const
+{
+    /* Your bounding box calculation goes here */
+
+    return AABB::infinite();
+}
+
 Example::Example(/* YOUR DATAMEMBERS HERE */)
 //:
 // See sphere.cpp how to initialize your data members
@@ -9,6 +9,7 @@ class Example: public Object
         Example(/* YOUR DATA MEMBERS HERE*/);
 
         virtual Hit intersect(Ray const &ray);
+        virtual AABB boundingBox() const;
 
         /* YOUR DATA MEMBERS HERE*/
 };
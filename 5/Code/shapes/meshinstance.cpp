@@ -0,0 +1,84 @@
+#include "meshinstance.h"
+
+MeshInstance::MeshInstance(TriangleMeshPtr const &mesh,
+                           Transform const &toWorld)
+:
+    d_mesh(mesh),
+    d_toWorld(toWorld),
+    d_toObject(toWorld.inverse())
+{}
+
+TriangleMeshPtr const &MeshInstance::mesh() const
+{
+    return d_mesh;
+}
+
+Transform const &MeshInstance::toWorld() const
+{
+    return d_toWorld;
+}
+
+void MeshInstance::setToWorld(Transform const &toWorld)
+{
+    d_toWorld = toWorld;
+    d_toObject = toWorld.inverse();
+}
+
+Hit MeshInstance::intersect(Ray const &ray)
+{
+    return deferredHit(ray);
+}
+
+Real MeshInstance::distance(Ray const &ray, unsigned &prim)
+{
+    return d_mesh->distance(d_toObject.ray(ray), prim);
+}
+
+Vector MeshInstance::normal(Ray const &ray, Real t, unsigned prim)
+{
+    // normals transform by the inverse transpose, which keeps them facing
+    // the (transformed) ray
+    Vector N = d_mesh->normal(d_toObject.ray(ray), t, prim);
+    return d_toObject.normal(N).normalized();
+}
+
+bool MeshInstance::occluded(Ray const &ray, Real tMax)
+{
+    return d_mesh->occluded(d_toObject.ray(ray), tMax);
+}
+
+AABB MeshInstance::boundingBox() const
+{
+    return d_toWorld.box(d_mesh->boundingBox());
+}
+
+void MeshInstance::intersectPacket(RayPacket const &packet, PacketHit &hit,
+                                   int id, PacketKernels const &kernels)
+{
+    RayPacket local;
+    for (unsigned lane = 0; lane != kernels.width; ++lane)
+    {
+        Point O = d_toObject.point(
+            Point(packet.ox[lane], packet.oy[lane], packet.oz[lane]));
+        Vector D = d_toObject.vector(
+            Vector(packet.dx[lane], packet.dy[lane], packet.dz[lane]));
+        local.ox[lane] = O.x;
+        local.oy[lane] = O.y;
+        local.oz[lane] = O.z;
+        local.dx[lane] = D.x;
+        local.dy[lane] = D.y;
+        local.dz[lane] = D.z;
+    }
+    d_mesh->intersectPacket(local, hit, id, kernels);
+
+    // only this instance writes id, so those lanes hold object normals
+    for (unsigned lane = 0; lane != kernels.width; ++lane)
+        if (hit.id[lane] == id)
+        {
+            Vector N = d_toObject.normal(
+                Vector(hit.nx[lane], hit.ny[lane], hit.nz[lane])).normalized();
+            hit.nx[lane] = N.x;
+            hit.ny[lane] = N.y;
+            hit.nz[lane] = N.z;
+        }
+}
@@ -0,0 +1,42 @@
+#ifndef MESHINSTANCE_H_
+#define MESHINSTANCE_H_
+
+#include "../object.h"
+#include "../transform.h"
+#include "trianglemesh.h"
+
+#include <memory>
+
+typedef std::shared_ptr<TriangleMesh> TriangleMeshPtr;
+
+// A triangle mesh placed in the scene by an affine transformation. The
+// mesh (vertices and its BVH) is shared by all instances of the same
+// model; an instance only holds the transformations and its material.
+// Rays are moved into the space of the mesh instead of moving the mesh:
+// the direction is not normalized there, so distances carry over as is.
+class MeshInstance: public Object
+{
+    TriangleMeshPtr d_mesh;
+    Transform d_toWorld;
+    Transform d_toObject;       // the inverse of d_toWorld
+
+    public:
+        MeshInstance(TriangleMeshPtr const &mesh, Transform const &toWorld);
+
+        TriangleMeshPtr const &mesh() const;
+        Transform const &toWorld() const;
+
+        // move the instance (e.g. per animation frame), the scene's
+        // acceleration structure has to be refitted afterwards
+        void setToWorld(Transform const &toWorld);
+
+        virtual Hit intersect(Ray const &ray);
+        virtual Real distance(Ray const &ray, unsigned &prim);
+        virtual Vector normal(Ray const &ray, Real t, unsigned prim);
+        virtual bool occluded(Ray const &ray, Real tMax);
+        virtual AABB boundingBox() const;
+        virtual void intersectPacket(RayPacket const &packet, PacketHit &hit,
+                                     int id, PacketKernels const &kernels);
+};
+
+#endif
@@ -1,24 +1,37 @@
 #include "plane.h"
 
-#include <cmath>
+#include "../renderstats.h"
 
-constexpr float kEpsilon = 1e-6;
+#include <cmath>
+#include <limits>
 
 Hit Plane::intersect(Ray const &ray)
 {
-    /* Your intersect calculation goes here */
-    double denom = N.dot(ray.D);
-    if (fabs(denom) >= kEpsilon) {
-        Triple p0O = p0 - ray.O;
-        double t = p0O.dot(N) / denom;
-        if (t >= 0)
-            return Hit(t, N);
-    }
-    return Hit::NO_HIT();
+    return deferredHit(ray);
+}
+
+Vector Plane::normal(Ray const &, Real, unsigned)
+{
+    return N;
+}
+
+void Plane::intersectPacket(RayPacket const &packet, PacketHit &hit,
+                            int id, PacketKernels const &kernels)
+{
+    threadCounters().tests[RayCounters::PLANE] += kernels.width;
+    float point[3] = {float(p0.x), float(p0.y), float(p0.z)};
+    float normal[3] = {float(N.x), float(N.y), float(N.z)};
+    kernels.plane(packet, hit, id, point, normal);
+}
+
+AABB Plane::boundingBox() const
+{
+    return AABB::infinite();    // a plane is unbounded
 }
 
 Plane::Plane(Point const &p0, Triple const &N)
 :
+    Object(ShapeKind::PLANE),
     p0(p0),
     N(N.normalized())
 {}
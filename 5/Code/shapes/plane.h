@@ -2,17 +2,44 @@
 #define PLANE_H_
 
 #include "../object.h"
+#include "../renderstats.h"
 
-class Plane : public Object
+#include <cmath>
+#include <limits>
+
+class Plane final : public Object
 {
   public:
     Plane(Point const &p0, Triple const &N);
 
     virtual Hit intersect(Ray const &ray);
+    virtual Real distance(Ray const &ray, unsigned &prim);
+    virtual Vector normal(Ray const &ray, Real t, unsigned prim);
+    virtual AABB boundingBox() const;
+    virtual void intersectPacket(RayPacket const &packet, PacketHit &hit,
+                                 int id, PacketKernels const &kernels);
 
     /* YOUR DATA MEMBERS HERE*/
     Point const p0;
     Triple const N;
+
+  private:
+    static constexpr float kEpsilon = 1e-6;
 };
 
+inline Real Plane::distance(Ray const &ray, unsigned &prim)
+{
+    /* Your intersect calculation goes here */
+    ++threadCounters().tests[RayCounters::PLANE];
+    prim = 0;
+    Real denom = N.dot(ray.D);
+    if (std::fabs(denom) >= kEpsilon) {
+        Triple p0O = p0 - ray.O;
+        Real t = p0O.dot(N) / denom;
+        if (t >= 0)
+            return t;
+    }
+    return std::numeric_limits<Real>::infinity();
+}
+
 #endif
@@ -1,44 +1,18 @@
 #include "sphere.h"
-#include "../solveQ.h"
+#include "../renderstats.h"
 
 #include <cmath>
+#include <limits>
 
 using namespace std;
 
 Hit Sphere::intersect(Ray const &ray)
 {
-    /****************************************************
-    * RT1.1: INTERSECTION CALCULATION
-    *
-    * Given: ray, position, r
-    * Sought: intersects? if true: *t
-    *
-    * Insert calculation of ray/sphere intersection here.
-    *
-    * You have the sphere's center (C) and radius (r) as well as
-    * the ray's origin (ray.O) and direction (ray.D).
-    *
-    * If the ray does not intersect the sphere, return false.
-    * Otherwise, return true and place the distance of the
-    * intersection point from the ray origin in *t (see example).
-    ****************************************************/
-
-    // Calculation of the intersections with the sphere with an analytic method
-    Triple OC = ray.O - position;
-    float t0, t1;
-    float a = ray.D.dot(ray.D);
-    float b = 2 * ray.D.dot(OC);
-    float c = OC.dot(OC) - (r*r);
-    if (!solveQuadratic(a, b, c, t0, t1))
-        return Hit::NO_HIT();
-    if (t0 < 0) {
-        t0 = t1; // if t0 is negative, let's use t1 instead
-        if (t0 < 0)
-            return Hit::NO_HIT(); // both t0 and t1 are negative
-    }
-    // Let's use the closest distance to know wich sphere is closer to the camera
-    double t = t0;
+    return deferredHit(ray);
+}
 
+Vector Sphere::normal(Ray const &ray, Real t, unsigned)
+{
     /****************************************************
     * RT1.2: NORMAL CALCULATION
     *
@@ -48,13 +22,48 @@ Hit Sphere::intersect(Ray const &ray)
     * Insert calculation of the sphere's normal at the intersection point.
     ****************************************************/
     Vector P = ray.O + ray.D * t;
-    Vector N = (P - position).normalized() ;
+    return (P - position).normalized();
+}
 
-    return Hit(t,N);
+void Sphere::intersectPacket(RayPacket const &packet, PacketHit &hit,
+                             int id, PacketKernels const &kernels)
+{
+    threadCounters().tests[RayCounters::SPHERE] += kernels.width;
+    float center[3] = {float(position.x), float(position.y), float(position.z)};
+    kernels.sphere(packet, hit, id, center, r);
 }
 
-Sphere::Sphere(Point const &pos, double radius)
+AABB Sphere::boundingBox() const
+{
+    return AABB(position - r, position + r);
+}
+
+bool Sphere::textureCoordinates(Point const &p, Real &u, Real &v,
+                                Real &size) const
+{
+    Vector N = (p - position) / r;
+    Real longitude = atan2(N.dot(d_east), N.dot(d_meridian));
+    u = longitude / (2 * M_PI);
+    u -= floor(u);
+    v = acos(max(Real(-1), min(Real(1), N.dot(axis)))) / M_PI;
+    size = 2 * M_PI * r;
+    return true;
+}
+
+Sphere::Sphere(Point const &pos, Real radius, Vector const &axis, Real angle)
 :
+    Object(ShapeKind::SPHERE),
     position(pos),
-    r(radius)
-{}
+    r(radius),
+    axis(axis.normalized()),
+    angle(angle)
+{
+    // any vector perpendicular to the axis, rotated by angle about it
+    Vector const &A = this->axis;
+    Vector helper = fabs(A.z) < 0.9 ? Vector(0, 0, 1) : Vector(1, 0, 0);
+    Vector meridian = A.cross(helper).normalized();
+    Vector east = A.cross(meridian);
+    Real radians = angle * M_PI / 180;
+    d_meridian = cos(radians) * meridian + sin(radians) * east;
+    d_east = A.cross(d_meridian);
+}
@@ -2,16 +2,83 @@
 #define SPHERE_H_
 
 #include "../object.h"
+#include "../renderstats.h"
 
-class Sphere: public Object
+#include <cmath>
+#include <limits>
+#include <utility>
+
+class Sphere final: public Object
 {
     public:
-        Sphere(Point const &pos, double radius);
+        // the texture's poles are on the axis, its left edge is rotated
+        // about it by angle degrees
+        Sphere(Point const &pos, Real radius,
+               Vector const &axis = Vector(0, 1, 0), Real angle = 0);
 
         virtual Hit intersect(Ray const &ray);
+        virtual Real distance(Ray const &ray, unsigned &prim);
+        virtual Vector normal(Ray const &ray, Real t, unsigned prim);
+        virtual bool textureCoordinates(Point const &p, Real &u, Real &v,
+                                        Real &size) const;
+        virtual AABB boundingBox() const;
+        virtual void intersectPacket(RayPacket const &packet, PacketHit &hit,
+                                     int id, PacketKernels const &kernels);
 
         Point const position;
-        double const r;
+        Real const r;
+        Vector const axis;
+        Real const angle;
+
+    private:
+        Vector d_meridian;      // u = 0 (perpendicular to the axis)
+        Vector d_east;          // u = 0.25
 };
 
+// in the header so Scene's traversal can inline it (see ShapeKind)
+inline Real Sphere::distance(Ray const &ray, unsigned &prim)
+{
+    /****************************************************
+    * RT1.1: INTERSECTION CALCULATION
+    *
+    * Given: ray, position, r
+    * Sought: intersects? if true: *t
+    *
+    * Insert calculation of ray/sphere intersection here.
+    *
+    * You have the sphere's center (C) and radius (r) as well as
+    * the ray's origin (ray.O) and direction (ray.D).
+    *
+    * If the ray does not intersect the sphere, return false.
+    * Otherwise, return true and place the distance of the
+    * intersection point from the ray origin in *t (see example).
+    ****************************************************/
+
+    ++threadCounters().tests[RayCounters::SPHERE];
+
+    // Analytic solution in Real, arranged so nothing cancels: b*b - 4ac
+    // loses all precision for a small sphere far from the ray origin, so
+    // the discriminant is taken from the distance between the centre and
+    // the point on the ray closest to it instead (Ray Tracing Gems, ch. 7)
+    Real const NO_HIT = std::numeric_limits<Real>::infinity();
+    prim = 0;
+    Vector OC = ray.O - position;
+    Real a = ray.D.dot(ray.D);
+    Real b = -OC.dot(ray.D);                // half of -b in the usual form
+    Real c = OC.dot(OC) - r * r;
+    Vector closest = OC + (b / a) * ray.D;  // centre -> closest point
+    Real discr = a * (r * r - closest.dot(closest));
+    if (discr < 0)
+        return NO_HIT;
+
+    Real q = b + std::copysign(std::sqrt(discr), b);
+    Real t0 = c / q;
+    Real t1 = q / a;
+    if (t0 > t1)
+        std::swap(t0, t1);
+    if (t0 > 0)
+        return t0;
+    return t1 > 0 ? t1 : NO_HIT;            // inside the sphere: far root
+}
+
 #endif
@@ -1,46 +1,40 @@
 #include "triangle.h"
 
-#include <cfloat>   // DBL_EPSILON
-#include <cmath>
-
 Hit Triangle::intersect(Ray const &ray)
 {
-    // Möller-Trumbore
-    Vector edge1(v1 - v0);
-    Vector edge2(v2 - v0);
-    Vector h = ray.D.cross(edge2);
-    double a = edge1.dot(h);
-    if (a > - DBL_EPSILON && a < DBL_EPSILON)
-        return Hit::NO_HIT();
-
-    double f = 1 / a;
-    Vector s = ray.O - v0;
-    double u = f * s.dot(h);
-    if (u < 0.0 || u > 1.0)
-        return Hit::NO_HIT();
-
-    Vector q = s.cross(edge1);
-    double v = f * ray.D.dot(q);
-    if (v < 0.0 || u + v > 1.0)
-        return Hit::NO_HIT();
-
-    double t = f * edge2.dot(q);
-
-    if (t <= DBL_EPSILON)    // line intersection (not ray)
-        return Hit::NO_HIT();
+    return deferredHit(ray);
+}
 
+Vector Triangle::normal(Ray const &ray, Real, unsigned)
+{
     // determine orientation of the normal
-    Vector normal = N;
-    if (N.dot(ray.D) > 0)
-        normal = -normal;
+    return N.dot(ray.D) > 0 ? -N : N;
+}
+
+void Triangle::intersectPacket(RayPacket const &packet, PacketHit &hit,
+                               int id, PacketKernels const &kernels)
+{
+    threadCounters().tests[RayCounters::TRIANGLE] += kernels.width;
+    float a[3] = {float(v0.x), float(v0.y), float(v0.z)};
+    float b[3] = {float(v1.x), float(v1.y), float(v1.z)};
+    float c[3] = {float(v2.x), float(v2.y), float(v2.z)};
+    kernels.triangle(packet, hit, id, a, b, c);
+}
 
-    return Hit(t, normal);
+AABB Triangle::boundingBox() const
+{
+    AABB box;
+    box.extend(v0);
+    box.extend(v1);
+    box.extend(v2);
+    return box;
 }
 
 Triangle::Triangle(Point const &v0,
          Point const &v1,
          Point const &v2)
 :
+    Object(ShapeKind::TRIANGLE),
     v0(v0),
     v1(v1),
     v2(v2),
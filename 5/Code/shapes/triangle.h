@@ -1,9 +1,12 @@
 #ifndef TRIANGLE_H_
 #define TRIANGLE_H_
 
+#include "watertight.h"
+
 #include "../object.h"
+#include "../renderstats.h"
 
-class Triangle: public Object
+class Triangle final: public Object
 {
     public:
         Triangle(Point const &v0,
@@ -11,6 +14,11 @@ class Triangle: public Object
                  Point const &v2);
 
         virtual Hit intersect(Ray const &ray);
+        virtual Real distance(Ray const &ray, unsigned &prim);
+        virtual Vector normal(Ray const &ray, Real t, unsigned prim);
+        virtual AABB boundingBox() const;
+        virtual void intersectPacket(RayPacket const &packet, PacketHit &hit,
+                                     int id, PacketKernels const &kernels);
 
         Point v0;
         Point v1;
@@ -18,4 +26,11 @@ class Triangle: public Object
         Vector N;
 };
 
+inline Real Triangle::distance(Ray const &ray, unsigned &prim)
+{
+    ++threadCounters().tests[RayCounters::TRIANGLE];
+    prim = 0;
+    return WatertightRay(ray).intersect(v0, v1, v2);
+}
+
 #endif
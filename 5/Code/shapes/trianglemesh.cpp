@@ -0,0 +1,174 @@
+#include "trianglemesh.h"
+
+#include "../renderstats.h"
+
+#include <cmath>
+#include <limits>
+
+using namespace std;
+
+template <typename Scalar>
+void TriangleMeshT<Scalar>::reserve(size_t numTriangles)
+{
+    for (unsigned axis = 0; axis != 3; ++axis)
+    {
+        d_v0[axis].reserve(numTriangles);
+        d_v1[axis].reserve(numTriangles);
+        d_v2[axis].reserve(numTriangles);
+    }
+}
+
+template <typename Scalar>
+void TriangleMeshT<Scalar>::addTriangle(Point const &v0,
+                                      Point const &v1,
+                                      Point const &v2)
+{
+    for (unsigned axis = 0; axis != 3; ++axis)
+    {
+        d_v0[axis].push_back(v0.data[axis]);
+        d_v1[axis].push_back(v1.data[axis]);
+        d_v2[axis].push_back(v2.data[axis]);
+    }
+}
+
+template <typename Scalar>
+void TriangleMeshT<Scalar>::build()
+{
+    vector<AABB> boxes(size());
+    for (size_t idx = 0; idx != size(); ++idx)
+        for (unsigned corner = 0; corner != 3; ++corner)
+            boxes[idx].extend(vertex(idx, corner));
+    d_bvh.build(boxes);
+
+    // store the triangles in leaf order
+    vector<unsigned> order = d_bvh.reorderPrimitives();
+    vector<Scalar> tmp(order.size());
+    for (vector<Scalar> *array : {d_v0, d_v1, d_v2})
+        for (unsigned axis = 0; axis != 3; ++axis)
+        {
+            for (size_t idx = 0; idx != order.size(); ++idx)
+                tmp[idx] = array[axis][order[idx]];
+            array[axis].swap(tmp);
+        }
+}
+
+template <typename Scalar>
+size_t TriangleMeshT<Scalar>::size() const
+{
+    return d_v0[0].size();
+}
+
+template <typename Scalar>
+void TriangleMeshT<Scalar>::write(BlobWriter &out) const
+{
+    for (vector<Scalar> const *array : {d_v0, d_v1, d_v2})
+        for (unsigned axis = 0; axis != 3; ++axis)
+            out.writeArray(array[axis]);
+    d_bvh.write(out);
+}
+
+template <typename Scalar>
+void TriangleMeshT<Scalar>::read(BlobReader &in)
+{
+    for (vector<Scalar> *array : {d_v0, d_v1, d_v2})
+        for (unsigned axis = 0; axis != 3; ++axis)
+            in.readArray(array[axis]);
+    d_bvh.read(in);
+}
+
+template <typename Scalar>
+Hit TriangleMeshT<Scalar>::intersect(Ray const &ray)
+{
+    return deferredHit(ray);
+}
+
+template <typename Scalar>
+Real TriangleMeshT<Scalar>::distance(Ray const &ray, unsigned &prim)
+{
+    WatertightRay sheared(ray);
+    Real tMin = numeric_limits<Real>::infinity();
+    prim = size();
+    d_bvh.traverse(ray, tMin, [&](unsigned idx, Real &tMax)
+    {
+        Real t = intersectTriangle(sheared, idx);
+        if (t < tMax)
+        {
+            tMax = tMin = t;
+            prim = idx;
+        }
+        return false;
+    });
+    return tMin;
+}
+
+template <typename Scalar>
+Vector TriangleMeshT<Scalar>::normal(Ray const &ray, Real, unsigned prim)
+{
+    Vector N = faceNormal(prim);
+    return N.dot(ray.D) > 0 ? -N : N;
+}
+
+template <typename Scalar>
+bool TriangleMeshT<Scalar>::occluded(Ray const &ray, Real tMax)
+{
+    WatertightRay sheared(ray);
+    bool hit = false;
+    d_bvh.traverse(ray, tMax, [&](unsigned idx, Real &tLimit)
+    {
+        hit = intersectTriangle(sheared, idx) < tLimit;
+        return hit;     // any triangle will do
+    });
+    return hit;
+}
+
+template <typename Scalar>
+void TriangleMeshT<Scalar>::intersectPacket(RayPacket const &packet,
+                                          PacketHit &hit, int id,
+                                          PacketKernels const &kernels)
+{
+    d_bvh.traversePacket(packet, hit, kernels, [&](unsigned idx)
+    {
+        threadCounters().tests[RayCounters::MESH_TRIANGLE] += kernels.width;
+        float v0[3], v1[3], v2[3];
+        for (unsigned axis = 0; axis != 3; ++axis)
+        {
+            v0[axis] = d_v0[axis][idx];
+            v1[axis] = d_v1[axis][idx];
+            v2[axis] = d_v2[axis][idx];
+        }
+        kernels.triangle(packet, hit, id, v0, v1, v2);
+    });
+}
+
+template <typename Scalar>
+AABB TriangleMeshT<Scalar>::boundingBox() const
+{
+    return d_bvh.bounds();
+}
+
+// --- Private -----------------------------------------------------------------
+
+template <typename Scalar>
+inline Real TriangleMeshT<Scalar>::intersectTriangle(WatertightRay const &ray,
+                                                     size_t idx) const
+{
+    ++threadCounters().tests[RayCounters::MESH_TRIANGLE];
+    return ray.intersect(vertex(idx, 0), vertex(idx, 1), vertex(idx, 2));
+}
+
+template <typename Scalar>
+Vector TriangleMeshT<Scalar>::faceNormal(size_t idx) const
+{
+    Point v0 = vertex(idx, 0);
+    return (vertex(idx, 1) - v0).cross(vertex(idx, 2) - v0).normalized();
+}
+
+template <typename Scalar>
+inline Point TriangleMeshT<Scalar>::vertex(size_t idx, unsigned corner) const
+{
+    vector<Scalar> const *v = corner == 0 ? d_v0 : (corner == 1 ? d_v1 : d_v2);
+    return Point(v[0][idx], v[1][idx], v[2][idx]);
+}
+
+template class TriangleMeshT<float>;
+template class TriangleMeshT<double>;
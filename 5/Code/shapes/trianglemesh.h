@@ -0,0 +1,62 @@
+#ifndef TRIANGLEMESH_H_
+#define TRIANGLEMESH_H_
+
+#include "../bvh.h"
+#include "../object.h"
+#include "watertight.h"
+
+#include <cstddef>
+#include <vector>
+
+// Precision in which mesh vertex data is stored. Arithmetic is done in
+// Real, float storage halves the memory streamed per triangle.
+#ifdef MESH_DOUBLE_PRECISION
+typedef double MeshReal;
+#else
+typedef float MeshReal;
+#endif
+
+// A whole triangle mesh (e.g. an OBJ model) as one object: one material,
+// one virtual call per ray. The vertices of the triangles are stored as a
+// structure of arrays in the leaf order of the mesh's own BVH. Rays are
+// tested with the watertight test, which needs the vertices themselves:
+// edges recomputed from v0 + edge would differ between neighbours.
+template <typename Scalar>
+class TriangleMeshT: public Object
+{
+    std::vector<Scalar> d_v0[3];      // vertices, per axis
+    std::vector<Scalar> d_v1[3];
+    std::vector<Scalar> d_v2[3];
+    BVH d_bvh;
+
+    public:
+        void reserve(size_t numTriangles);
+        void addTriangle(Point const &v0, Point const &v1, Point const &v2);
+
+        // build the BVH, call once all triangles are added
+        void build();
+
+        size_t size() const;
+
+        // store / restore the triangles and the built BVH (scene cache)
+        void write(BlobWriter &out) const;
+        void read(BlobReader &in);
+
+        virtual Hit intersect(Ray const &ray);
+        virtual Real distance(Ray const &ray, unsigned &prim);
+        virtual Vector normal(Ray const &ray, Real t, unsigned prim);
+        virtual bool occluded(Ray const &ray, Real tMax);
+        virtual AABB boundingBox() const;
+        virtual void intersectPacket(RayPacket const &packet, PacketHit &hit,
+                                     int id, PacketKernels const &kernels);
+
+    private:
+        Real intersectTriangle(WatertightRay const &ray, size_t idx) const;
+        Vector faceNormal(size_t idx) const;
+
+        Point vertex(size_t idx, unsigned corner) const;
+};
+
+typedef TriangleMeshT<MeshReal> TriangleMesh;
+
+#endif
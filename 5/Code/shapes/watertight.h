@@ -0,0 +1,92 @@
+#ifndef WATERTIGHT_H_
+#define WATERTIGHT_H_
+
+#include "../ray.h"
+
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+// Watertight ray/triangle intersection (Woop, Benthin and Wald, JCGT 2013).
+// The ray is sheared so it runs along +z from the origin, the triangle is
+// then tested in 2D by edge functions. Triangles sharing an edge compute
+// the same edge function for it, so no ray slips through between them,
+// whatever the precision. The shear is set up once per ray and reused for
+// every triangle it is tested against.
+class WatertightRay
+{
+    Point d_origin;
+    unsigned d_kx, d_ky, d_kz;  // the axes mapped to x, y and z
+    Real d_sx, d_sy, d_sz;      // the shear
+
+    public:
+        explicit WatertightRay(Ray const &ray);
+
+        // distance to the triangle (a, b, c), infinity if it is missed
+        Real intersect(Point const &a, Point const &b, Point const &c) const;
+};
+
+inline WatertightRay::WatertightRay(Ray const &ray)
+:
+    d_origin(ray.O)
+{
+    Vector const &D = ray.D;
+    Real absX = std::fabs(D.x);
+    Real absY = std::fabs(D.y);
+    Real absZ = std::fabs(D.z);
+    d_kz = absX > absY ? (absX > absZ ? 0 : 2) : (absY > absZ ? 1 : 2);
+    d_kx = (d_kz + 1) % 3;
+    d_ky = (d_kx + 1) % 3;
+    if (D.data[d_kz] < 0)
+        std::swap(d_kx, d_ky);      // keep the winding of the triangles
+
+    d_sx = D.data[d_kx] / D.data[d_kz];
+    d_sy = D.data[d_ky] / D.data[d_kz];
+    d_sz = 1 / D.data[d_kz];
+}
+
+inline Real WatertightRay::intersect(Point const &a, Point const &b,
+                                     Point const &c) const
+{
+    Real const NO_HIT = std::numeric_limits<Real>::infinity();
+
+    Vector A = a - d_origin;
+    Vector B = b - d_origin;
+    Vector C = c - d_origin;
+
+    Real ax = A.data[d_kx] - d_sx * A.data[d_kz];
+    Real ay = A.data[d_ky] - d_sy * A.data[d_kz];
+    Real bx = B.data[d_kx] - d_sx * B.data[d_kz];
+    Real by = B.data[d_ky] - d_sy * B.data[d_kz];
+    Real cx = C.data[d_kx] - d_sx * C.data[d_kz];
+    Real cy = C.data[d_ky] - d_sy * C.data[d_kz];
+
+    // edge functions, 0 means the ray passes exactly through the edge
+    Real u = cx * by - cy * bx;
+    Real v = ax * cy - ay * cx;
+    Real w = bx * ay - by * ax;
+
+    // in single precision an exact 0 may be rounding, decide in double
+    if (std::is_same<Real, float>::value && (u == 0 || v == 0 || w == 0))
+    {
+        u = static_cast<double>(cx) * by - static_cast<double>(cy) * bx;
+        v = static_cast<double>(ax) * cy - static_cast<double>(ay) * cx;
+        w = static_cast<double>(bx) * ay - static_cast<double>(by) * ax;
+    }
+
+    if ((u < 0 || v < 0 || w < 0) && (u > 0 || v > 0 || w > 0))
+        return NO_HIT;
+
+    Real det = u + v + w;
+    if (det == 0)
+        return NO_HIT;              // the ray is in the plane of the triangle
+
+    Real az = d_sz * A.data[d_kz];
+    Real bz = d_sz * B.data[d_kz];
+    Real cz = d_sz * C.data[d_kz];
+    Real t = (u * az + v * bz + w * cz) / det;
+    return t > 0 ? t : NO_HIT;
+}
+
+#endif
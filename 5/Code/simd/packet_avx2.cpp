@@ -0,0 +1,35 @@
+#include "../packet.h"
+
+// 8 lanes, this file is compiled with -mavx2 (see CMakeLists.txt)
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace
+{
+    typedef float v8f __attribute__((vector_size(32)));
+    typedef int v8i __attribute__((vector_size(32)));
+
+    inline v8f vsqrt(v8f x)
+    {
+        return (v8f)_mm256_sqrt_ps((__m256)x);
+    }
+}
+
+#include "packet_kernels.h"
+
+PacketKernels const *packetKernelsAVX2()
+{
+    static PacketKernels const kernels = makeKernels<v8f, v8i, 8>("AVX2");
+    return &kernels;
+}
+
+#else
+
+PacketKernels const *packetKernelsAVX2()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,36 @@
+#include "../packet.h"
+
+// 16 lanes, this file is compiled with -mavx512f (see CMakeLists.txt)
+
+#if defined(__AVX512F__)
+
+#include <immintrin.h>
+
+namespace
+{
+    typedef float v16f __attribute__((vector_size(64)));
+    typedef int v16i __attribute__((vector_size(64)));
+
+    inline v16f vsqrt(v16f x)
+    {
+        // maskz form: the plain one trips -Wmaybe-uninitialized in GCC 12
+        return (v16f)_mm512_maskz_sqrt_ps(0xFFFF, (__m512)x);
+    }
+}
+
+#include "packet_kernels.h"
+
+PacketKernels const *packetKernelsAVX512()
+{
+    static PacketKernels const kernels = makeKernels<v16f, v16i, 16>("AVX-512");
+    return &kernels;
+}
+
+#else
+
+PacketKernels const *packetKernelsAVX512()
+{
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef PACKET_KERNELS_H_
+#define PACKET_KERNELS_H_
+
+// Width independent packet kernels, written with the GCC/Clang vector
+// extensions. Every simd/packet_*.cpp includes this header after defining
+// its vector types and vsqrt, and is compiled for its own instruction set.
+// The kernels have internal linkage so instantiations for different
+// instruction sets can not be mixed up by the linker.
+
+#include "../packet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>  // memcpy
+
+namespace
+{
+    template <typename vf>
+    inline vf load(float const *src)
+    {
+        vf dst;
+        memcpy(&dst, src, sizeof(vf));
+        return dst;
+    }
+
+    template <typename vf>
+    inline void store(float *dst, vf src)
+    {
+        memcpy(dst, &src, sizeof(vf));
+    }
+
+    template <typename vi>
+    inline vi loadi(int const *src)
+    {
+        vi dst;
+        memcpy(&dst, src, sizeof(vi));
+        return dst;
+    }
+
+    template <typename vi>
+    inline void storei(int *dst, vi src)
+    {
+        memcpy(dst, &src, sizeof(vi));
+    }
+
+    template <typename vi, unsigned W>
+    inline bool any(vi mask)
+    {
+        for (unsigned lane = 0; lane != W; ++lane)
+            if (mask[lane])
+                return true;
+        return false;
+    }
+
+    // rounds a Real bound outwards so float boxes stay conservative
+    inline float lower(Real value)
+    {
+        float result = static_cast<float>(value);
+        return result > value ? std::nextafter(result, -INFINITY) : result;
+    }
+
+    inline float upper(Real value)
+    {
+        float result = static_cast<float>(value);
+        return result < value ? std::nextafter(result, INFINITY) : result;
+    }
+
+    // write the lanes in mask to the hit record
+    template <typename vf, typename vi>
+    inline void update(PacketHit &hit, vi mask, vf t,
+                       vf nx, vf ny, vf nz, int id)
+    {
+        store<vf>(hit.t, mask ? t : load<vf>(hit.t));
+        store<vf>(hit.nx, mask ? nx : load<vf>(hit.nx));
+        store<vf>(hit.ny, mask ? ny : load<vf>(hit.ny));
+        store<vf>(hit.nz, mask ? nz : load<vf>(hit.nz));
+        storei<vi>(hit.id, mask ? vi{} + id : loadi<vi>(hit.id));
+    }
+
+    template <typename vf, typename vi, unsigned W>
+    bool boxKernel(RayPacket const &packet, PacketHit const &hit,
+                   Real const min[3], Real const max[3], float &tNear)
+    {
+        float const *origin[3] = {packet.ox, packet.oy, packet.oz};
+        float const *dir[3] = {packet.dx, packet.dy, packet.dz};
+
+        vf t0 = vf{} + 0.0f;
+        vf t1 = load<vf>(hit.t);
+        for (unsigned axis = 0; axis != 3; ++axis)
+        {
+            vf invD = 1.0f / load<vf>(dir[axis]);
+            vf o = load<vf>(origin[axis]);
+            vf tA = (lower(min[axis]) - o) * invD;
+            vf tB = (upper(max[axis]) - o) * invD;
+            // NaNs (0 * inf on a flat box) are dropped like in AABB
+            vf tLo = tB < tA ? tB : tA;
+            vf tHi = tA < tB ? tB : tA;
+            t0 = t0 < tLo ? tLo : t0;
+            t1 = tHi < t1 ? tHi : t1;
+        }
+
+        vi mask = t0 <= t1;
+        if (!any<vi, W>(mask))
+            return false;
+
+        vf entry = mask ? t0 : vf{} + INFINITY;
+        tNear = entry[0];
+        for (unsigned lane = 1; lane != W; ++lane)
+            tNear = std::min(tNear, entry[lane]);
+        return true;
+    }
+
+    // same steps as Sphere::intersect and solveQuadratic
+    template <typename vf, typename vi, unsigned W>
+    void sphereKernel(RayPacket const &packet, PacketHit &hit, int id,
+                      float const center[3], float radius)
+    {
+        vf dx = load<vf>(packet.dx), dy = load<vf>(packet.dy),
+           dz = load<vf>(packet.dz);
+        vf ocx = load<vf>(packet.ox) - center[0];
+        vf ocy = load<vf>(packet.oy) - center[1];
+        vf ocz = load<vf>(packet.oz) - center[2];
+
+        vf a = dx * dx + dy * dy + dz * dz;
+        vf b = 2.0f * (dx * ocx + dy * ocy + dz * ocz);
+        vf c = ocx * ocx + ocy * ocy + ocz * ocz - radius * radius;
+        vf discr = b * b - 4.0f * a * c;
+        vi valid = discr >= 0.0f;
+        if (!any<vi, W>(valid))
+            return;
+
+        vf root = vsqrt(valid ? discr : vf{});
+        vf q = b > 0.0f ? -0.5f * (b + root) : -0.5f * (b - root);
+        vf x0 = q / a;
+        vf x1 = c / q;
+        vf t0 = x0 < x1 ? x0 : x1;
+        vf t1 = x0 < x1 ? x1 : x0;
+        vf t = t0 < 0.0f ? t1 : t0;     // use the far root if inside
+
+        vi mask = valid & (t >= 0.0f) & (t < load<vf>(hit.t));
+        if (!any<vi, W>(mask))
+            return;
+
+        vf invR = vf{} + 1.0f / radius;
+        vf nx = (load<vf>(packet.ox) + t * dx - center[0]) * invR;
+        vf ny = (load<vf>(packet.oy) + t * dy - center[1]) * invR;
+        vf nz = (load<vf>(packet.oz) + t * dz - center[2]) * invR;
+        update<vf, vi>(hit, mask, t, nx, ny, nz, id);
+    }
+
+    // same steps as Plane::intersect
+    template <typename vf, typename vi, unsigned W>
+    void planeKernel(RayPacket const &packet, PacketHit &hit, int id,
+                     float const p0[3], float const normal[3])
+    {
+        vf denom = normal[0] * load<vf>(packet.dx)
+                 + normal[1] * load<vf>(packet.dy)
+                 + normal[2] * load<vf>(packet.dz);
+        vf dist = normal[0] * (p0[0] - load<vf>(packet.ox))
+                + normal[1] * (p0[1] - load<vf>(packet.oy))
+                + normal[2] * (p0[2] - load<vf>(packet.oz));
+        vf t = dist / denom;
+
+        vf absDenom = denom < 0.0f ? -denom : denom;
+        vi mask = (absDenom >= 1e-6f) & (t >= 0.0f) & (t < load<vf>(hit.t));
+        if (!any<vi, W>(mask))
+            return;
+
+        update<vf, vi>(hit, mask, t, vf{} + normal[0], vf{} + normal[1],
+                       vf{} + normal[2], id);
+    }
+
+    // (x, y, z) in the axis order of the lanes' watertight shear: z is the
+    // axis of kz, x and y follow it and are swapped where swap is set
+    template <typename vf, typename vi>
+    inline void shearAxes(vi kz0, vi kz1, vi swap, vf x, vf y, vf z,
+                          vf &px, vf &py, vf &pz)
+    {
+        pz = kz0 ? x : (kz1 ? y : z);
+        vf a = kz0 ? y : (kz1 ? z : x);
+        vf b = kz0 ? z : (kz1 ? x : y);
+        px = swap ? b : a;
+        py = swap ? a : b;
+    }
+
+    // same steps as WatertightRay, per lane
+    template <typename vf, typename vi, unsigned W>
+    void triangleKernel(RayPacket const &packet, PacketHit &hit, int id,
+                        float const v0[3], float const v1[3],
+                        float const v2[3])
+    {
+        vf dx = load<vf>(packet.dx), dy = load<vf>(packet.dy),
+           dz = load<vf>(packet.dz);
+        vf ox = load<vf>(packet.ox), oy = load<vf>(packet.oy),
+           oz = load<vf>(packet.oz);
+
+        // the largest component of D is sheared to z
+        vf absX = dx < 0.0f ? -dx : dx;
+        vf absY = dy < 0.0f ? -dy : dy;
+        vf absZ = dz < 0.0f ? -dz : dz;
+        vi kz0 = (absX > absY) & (absX > absZ);
+        vi kz1 = ~(absX > absY) & (absY > absZ);
+        vi swap = (kz0 ? dx : (kz1 ? dy : dz)) < 0.0f;   // keep the winding
+        vf Dx, Dy, Dz;
+        shearAxes<vf, vi>(kz0, kz1, swap, dx, dy, dz, Dx, Dy, Dz);
+        vf sx = Dx / Dz;
+        vf sy = Dy / Dz;
+        vf sz = 1.0f / Dz;
+
+        vf Ax, Ay, Az, Bx, By, Bz, Cx, Cy, Cz;
+        shearAxes<vf, vi>(kz0, kz1, swap, v0[0] - ox, v0[1] - oy, v0[2] - oz,
+                          Ax, Ay, Az);
+        shearAxes<vf, vi>(kz0, kz1, swap, v1[0] - ox, v1[1] - oy, v1[2] - oz,
+                          Bx, By, Bz);
+        shearAxes<vf, vi>(kz0, kz1, swap, v2[0] - ox, v2[1] - oy, v2[2] - oz,
+                          Cx, Cy, Cz);
+
+        vf ax = Ax - sx * Az, ay = Ay - sy * Az;
+        vf bx = Bx - sx * Bz, by = By - sy * Bz;
+        vf cx = Cx - sx * Cz, cy = Cy - sy * Cz;
+
+        // edge functions, an exact 0 may be rounding: decide it in double
+        vf u = cx * by - cy * bx;
+        vf v = ax * cy - ay * cx;
+        vf w = bx * ay - by * ax;
+        vi zero = (u == 0.0f) | (v == 0.0f) | (w == 0.0f);
+        if (any<vi, W>(zero))
+        {
+            for (unsigned lane = 0; lane != W; ++lane)
+            {
+                if (!zero[lane])
+                    continue;
+                u[lane] = static_cast<double>(cx[lane]) * by[lane]
+                        - static_cast<double>(cy[lane]) * bx[lane];
+                v[lane] = static_cast<double>(ax[lane]) * cy[lane]
+                        - static_cast<double>(ay[lane]) * cx[lane];
+                w[lane] = static_cast<double>(bx[lane]) * ay[lane]
+                        - static_cast<double>(by[lane]) * ax[lane];
+            }
+        }
+
+        vi outside = ((u < 0.0f) | (v < 0.0f) | (w < 0.0f))
+                   & ((u > 0.0f) | (v > 0.0f) | (w > 0.0f));
+        vf det = u + v + w;
+        vi mask = ~outside & (det != 0.0f);
+        if (!any<vi, W>(mask))
+            return;
+
+        vf t = (u * (sz * Az) + v * (sz * Bz) + w * (sz * Cz)) / det;
+        mask &= (t > 0.0f) & (t < load<vf>(hit.t));
+        if (!any<vi, W>(mask))
+            return;
+
+        // the normal faces the ray origin
+        float edge1[3] = {v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]};
+        float edge2[3] = {v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]};
+        float n[3] = {edge1[1] * edge2[2] - edge1[2] * edge2[1],
+                      edge1[2] * edge2[0] - edge1[0] * edge2[2],
+                      edge1[0] * edge2[1] - edge1[1] * edge2[0]};
+        float invLen = 1.0f / std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        vf nx = vf{} + n[0] * invLen;
+        vf ny = vf{} + n[1] * invLen;
+        vf nz = vf{} + n[2] * invLen;
+        vi flip = nx * dx + ny * dy + nz * dz > 0.0f;
+        update<vf, vi>(hit, mask, t, flip ? -nx : nx, flip ? -ny : ny,
+                       flip ? -nz : nz, id);
+    }
+
+    template <typename vf, typename vi, unsigned W>
+    PacketKernels makeKernels(char const *name)
+    {
+        return PacketKernels{name, W,
+                             &boxKernel<vf, vi, W>,
+                             &sphereKernel<vf, vi, W>,
+                             &planeKernel<vf, vi, W>,
+                             &triangleKernel<vf, vi, W>};
+    }
+}
+
+#endif
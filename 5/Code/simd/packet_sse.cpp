@@ -0,0 +1,35 @@
+#include "../packet.h"
+
+// 4 lanes, SSE2 is part of the x86-64 baseline so no extra flags needed
+
+#if defined(__SSE2__)
+
+#include <immintrin.h>
+
+namespace
+{
+    typedef float v4f __attribute__((vector_size(16)));
+    typedef int v4i __attribute__((vector_size(16)));
+
+    inline v4f vsqrt(v4f x)
+    {
+        return (v4f)_mm_sqrt_ps((__m128)x);
+    }
+}
+
+#include "packet_kernels.h"
+
+PacketKernels const *packetKernelsSSE()
+{
+    static PacketKernels const kernels = makeKernels<v4f, v4i, 4>("SSE");
+    return &kernels;
+}
+
+#else
+
+PacketKernels const *packetKernelsSSE()
+{
+    return nullptr;
+}
+
+#endif
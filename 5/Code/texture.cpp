@@ -0,0 +1,205 @@
+#include "texture.h"
+
+#include "image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+    uint32_t pack(Color color)
+    {
+        color.clamp();
+        uint32_t texel = 0xff000000;    // opaque
+        for (unsigned channel = 0; channel != 3; ++channel)
+        {
+            Real value = max(color.data[channel], Real(0));
+            texel |= uint32_t(value * 255 + 0.5) << (8 * channel);
+        }
+        return texel;
+    }
+
+    Color unpack(uint32_t texel)
+    {
+        Real const scale = Real(1) / 255;
+        return Color((texel & 0xff) * scale,
+                     (texel >> 8 & 0xff) * scale,
+                     (texel >> 16 & 0xff) * scale);
+    }
+
+    // the mean of four texels, per channel
+    uint32_t average(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+    {
+        uint32_t texel = 0;
+        for (unsigned shift = 0; shift != 32; shift += 8)
+        {
+            uint32_t sum = (a >> shift & 0xff) + (b >> shift & 0xff)
+                           + (c >> shift & 0xff) + (d >> shift & 0xff);
+            texel |= (sum + 2) / 4 << shift;
+        }
+        return texel;
+    }
+}
+
+Texture::Texture(Image const &image)
+{
+    build(image);
+}
+
+Texture::Texture(string const &filename)
+{
+    Image image(filename);
+    if (image.size() == 0)
+        throw runtime_error("Could not read texture " + filename);
+    build(image);
+}
+
+unsigned Texture::width() const
+{
+    return d_levels.empty() ? 0 : d_levels[0].width;
+}
+
+unsigned Texture::height() const
+{
+    return d_levels.empty() ? 0 : d_levels[0].height;
+}
+
+unsigned Texture::levels() const
+{
+    return d_levels.size();
+}
+
+Color Texture::sample(Real u, Real v, Real footprint) const
+{
+    if (d_levels.empty())
+        return Color();
+
+    // the level whose texels are as large as the footprint
+    Real lod = log2(max(footprint * width(), Real(1)));
+    lod = min(lod, Real(d_levels.size() - 1));
+    unsigned fine = static_cast<unsigned>(lod);
+    Real blend = lod - fine;
+
+    Color color = bilinear(d_levels[fine], u, v);
+    if (blend > 0 && fine + 1 < d_levels.size())
+    {
+        Color coarse = bilinear(d_levels[fine + 1], u, v);
+        color = (1 - blend) * color + blend * coarse;
+    }
+    return color;
+}
+
+void Texture::write(BlobWriter &out) const
+{
+    out.writeArray(d_levels);
+    out.writeArray(d_texels);
+}
+
+void Texture::read(BlobReader &in)
+{
+    in.readArray(d_levels);
+    in.readArray(d_texels);
+    for (Level const &level : d_levels)
+        if (level.offset + size_t(level.tilesPerRow) * TILE * TILE
+                * ((level.height + TILE - 1) / TILE) > d_texels.size())
+            throw runtime_error("scene cache: invalid texture");
+}
+
+// --- Private -----------------------------------------------------------------
+
+// Level 0 is the image, every next level averages 2 x 2 texels of the
+// previous one (the last row or column is repeated for odd sizes)
+void Texture::build(Image const &image)
+{
+    unsigned width = image.width();
+    unsigned height = image.height();
+    vector<uint32_t> texels(size_t(width) * height);
+    for (unsigned y = 0; y != height; ++y)
+        for (unsigned x = 0; x != width; ++x)
+            texels[size_t(y) * width + x] = pack(image(x, y));
+
+    while (true)
+    {
+        // store the level in tiles, padded to whole tiles
+        Level level;
+        level.width = width;
+        level.height = height;
+        level.tilesPerRow = (width + TILE - 1) / TILE;
+        level.offset = d_texels.size();
+        unsigned tileRows = (height + TILE - 1) / TILE;
+        d_texels.resize(d_texels.size()
+                        + size_t(level.tilesPerRow) * tileRows * TILE * TILE);
+        d_levels.push_back(level);
+        for (unsigned y = 0; y != height; ++y)
+            for (unsigned x = 0; x != width; ++x)
+            {
+                size_t idx = level.offset
+                    + (size_t(y / TILE) * level.tilesPerRow + x / TILE)
+                      * TILE * TILE
+                    + (y % TILE) * TILE + x % TILE;
+                d_texels[idx] = texels[size_t(y) * width + x];
+            }
+
+        if (width == 1 && height == 1)
+            break;
+
+        unsigned nextWidth = max(width / 2, 1U);
+        unsigned nextHeight = max(height / 2, 1U);
+        vector<uint32_t> next(size_t(nextWidth) * nextHeight);
+        for (unsigned y = 0; y != nextHeight; ++y)
+        {
+            unsigned y0 = min(2 * y, height - 1);
+            unsigned y1 = min(2 * y + 1, height - 1);
+            for (unsigned x = 0; x != nextWidth; ++x)
+            {
+                unsigned x0 = min(2 * x, width - 1);
+                unsigned x1 = min(2 * x + 1, width - 1);
+                next[size_t(y) * nextWidth + x] = average(
+                    texels[size_t(y0) * width + x0],
+                    texels[size_t(y0) * width + x1],
+                    texels[size_t(y1) * width + x0],
+                    texels[size_t(y1) * width + x1]);
+            }
+        }
+        texels.swap(next);
+        width = nextWidth;
+        height = nextHeight;
+    }
+}
+
+inline uint32_t Texture::texel(Level const &level, unsigned x, unsigned y) const
+{
+    return d_texels[level.offset
+                    + ((y / TILE) * level.tilesPerRow + x / TILE) * TILE * TILE
+                    + (y % TILE) * TILE + x % TILE];
+}
+
+Color Texture::bilinear(Level const &level, Real u, Real v) const
+{
+    // texel centers are at half integer positions
+    Real x = u * level.width - Real(0.5);
+    Real y = v * level.height - Real(0.5);
+    Real fx = floor(x);
+    Real fy = floor(y);
+    Real wx = x - fx;
+    Real wy = y - fy;
+
+    // u wraps around, v is clamped
+    int width = level.width;
+    int height = level.height;
+    int x0 = static_cast<int>(fx) % width;
+    if (x0 < 0)
+        x0 += width;
+    int x1 = x0 + 1 == width ? 0 : x0 + 1;
+    int y0 = min(max(static_cast<int>(fy), 0), height - 1);
+    int y1 = min(max(static_cast<int>(fy) + 1, 0), height - 1);
+
+    Color top = (1 - wx) * unpack(texel(level, x0, y0))
+                + wx * unpack(texel(level, x1, y0));
+    Color bottom = (1 - wx) * unpack(texel(level, x0, y1))
+                   + wx * unpack(texel(level, x1, y1));
+    return (1 - wy) * top + wy * bottom;
+}
@@ -0,0 +1,64 @@
+#ifndef TEXTURE_H_
+#define TEXTURE_H_
+
+#include "blob.h"
+#include "triple.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Image;
+
+// Texture for lookups from arbitrary ray hits. Texels are stored as 8 bit
+// RGBA (4 bytes instead of the 24 of a Color) in tiles of 8 x 8 texels,
+// so a bilinear lookup touches one or two cache lines whatever its
+// direction, with a mip map of box filtered levels down to 1 x 1. Sampling
+// is trilinear: bilinear in the two levels closest to the footprint of the
+// lookup, blended. u wraps around, v is clamped.
+class Texture
+{
+    public:
+        enum { TILE = 8 };      // tiles of TILE x TILE texels
+
+    private:
+        struct Level
+        {
+            uint32_t width;
+            uint32_t height;
+            uint32_t tilesPerRow;
+            uint32_t offset;    // of the first texel in d_texels
+        };
+
+        std::vector<Level> d_levels;        // level 0 is the full size
+        std::vector<uint32_t> d_texels;     // RGBA, R in the lowest byte
+
+    public:
+        Texture() = default;
+        explicit Texture(Image const &image);
+        explicit Texture(std::string const &filename);     // a PNG file
+
+        unsigned width() const;
+        unsigned height() const;
+        unsigned levels() const;
+
+        // Color at (u, v), both 0 .. 1 from the top left corner of the
+        // image. footprint is the size of the area covered by the lookup
+        // in u units (e.g. of a pixel projected on the surface), it
+        // selects the mip levels; 0 samples the full size level.
+        Color sample(Real u, Real v, Real footprint) const;
+
+        // store / restore all levels (scene cache)
+        void write(BlobWriter &out) const;
+        void read(BlobReader &in);
+
+    private:
+        void build(Image const &image);
+        Color bilinear(Level const &level, Real u, Real v) const;
+        uint32_t texel(Level const &level, unsigned x, unsigned y) const;
+};
+
+typedef std::shared_ptr<Texture const> TexturePtr;
+
+#endif
@@ -0,0 +1,119 @@
+#include "threadpool.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(unsigned threads)
+:
+    d_size(threads != 0 ? threads : max(1U, thread::hardware_concurrency())),
+    d_workers(new Worker[d_size]),
+    d_remaining(0)
+{
+    for (unsigned worker = 1; worker < d_size; ++worker)
+        d_threads.emplace_back(&ThreadPool::threadMain, this, worker);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(d_mutex);
+        d_stop = true;
+    }
+    d_wake.notify_all();
+    for (thread &thr : d_threads)
+        thr.join();
+}
+
+unsigned ThreadPool::size() const
+{
+    return d_size;
+}
+
+void ThreadPool::run(unsigned numTasks, Job const &job)
+{
+    if (numTasks == 0)
+        return;
+
+    {
+        lock_guard<mutex> lock(d_mutex);
+        for (unsigned worker = 0; worker != d_size; ++worker)
+        {
+            lock_guard<mutex> workerLock(d_workers[worker].mutex);
+            unsigned first = static_cast<unsigned long long>(numTasks) * worker / d_size;
+            unsigned last = static_cast<unsigned long long>(numTasks) * (worker + 1) / d_size;
+            for (unsigned task = first; task != last; ++task)
+                d_workers[worker].tasks.push_back(task);
+        }
+        d_remaining = numTasks;
+        d_job = &job;
+        d_active = d_size;
+        ++d_batch;
+    }
+    d_wake.notify_all();
+
+    work(0);
+
+    // wait until every worker has left the batch (and dropped the job)
+    unique_lock<mutex> lock(d_mutex);
+    d_idle.wait(lock, [this]{ return d_active == 0; });
+    d_job = nullptr;
+}
+
+// --- Private -----------------------------------------------------------------
+
+void ThreadPool::threadMain(unsigned worker)
+{
+    unsigned batch = 0;
+    while (true)
+    {
+        {
+            unique_lock<mutex> lock(d_mutex);
+            d_wake.wait(lock, [&]{ return d_stop || d_batch != batch; });
+            if (d_stop)
+                return;
+            batch = d_batch;
+        }
+        work(worker);
+    }
+}
+
+void ThreadPool::work(unsigned worker)
+{
+    unsigned task;
+    while (d_remaining.load() != 0 && next(worker, task))
+    {
+        (*d_job)(task, worker);
+        --d_remaining;
+    }
+
+    lock_guard<mutex> lock(d_mutex);
+    if (--d_active == 0)
+        d_idle.notify_all();
+}
+
+// own deque from the front, then steal from the back of the others
+bool ThreadPool::next(unsigned worker, unsigned &task)
+{
+    {
+        Worker &own = d_workers[worker];
+        lock_guard<mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+
+    for (unsigned offset = 1; offset != d_size; ++offset)
+    {
+        Worker &victim = d_workers[(worker + offset) % d_size];
+        lock_guard<mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
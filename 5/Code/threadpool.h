@@ -0,0 +1,66 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work stealing thread pool for batches of independent tasks. Each worker
+// owns a deque of task indices: it works through its own deque from the
+// front and, once that runs dry, steals from the back of the others (the
+// work their owners would get to last).
+// The thread calling run() works along as worker 0.
+class ThreadPool
+{
+    public:
+        // job(task, worker) executes one task on the given worker
+        typedef std::function<void(unsigned, unsigned)> Job;
+
+    private:
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<unsigned> tasks;
+            char padding[64];       // keep workers on separate cache lines
+        };
+
+        unsigned d_size;
+        std::unique_ptr<Worker[]> d_workers;
+        std::vector<std::thread> d_threads;
+
+        std::mutex d_mutex;
+        std::condition_variable d_wake;     // a new batch or stop
+        std::condition_variable d_idle;     // a worker left the batch
+        Job const *d_job = nullptr;
+        unsigned d_batch = 0;               // counts batches, wakes workers
+        unsigned d_active = 0;              // workers inside the batch
+        bool d_stop = false;
+        std::atomic<unsigned> d_remaining;  // tasks not finished yet
+
+    public:
+        // threads == 0 uses one worker per hardware thread
+        explicit ThreadPool(unsigned threads = 0);
+        ~ThreadPool();
+
+        ThreadPool(ThreadPool const &) = delete;
+        ThreadPool &operator=(ThreadPool const &) = delete;
+
+        unsigned size() const;
+
+        // Run tasks 0 .. numTasks - 1 and wait for all of them. Tasks are
+        // handed out in contiguous blocks, one per worker, so neighbouring
+        // tasks tend to run on the same worker.
+        void run(unsigned numTasks, Job const &job);
+
+    private:
+        void threadMain(unsigned worker);
+        void work(unsigned worker);
+        bool next(unsigned worker, unsigned &task);
+};
+
+#endif
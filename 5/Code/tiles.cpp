@@ -0,0 +1,154 @@
+#include "tiles.h"
+
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
+
+using namespace std;
+
+namespace
+{
+    // interleave the bits of x and y
+    unsigned long long mortonKey(unsigned x, unsigned y)
+    {
+        unsigned long long key = 0;
+        for (unsigned bit = 0; bit != 32; ++bit)
+        {
+            key |= static_cast<unsigned long long>((x >> bit) & 1U) << (2 * bit);
+            key |= static_cast<unsigned long long>((y >> bit) & 1U) << (2 * bit + 1);
+        }
+        return key;
+    }
+
+    // distance along the Hilbert curve filling an n x n grid (n a power of 2)
+    unsigned long long hilbertKey(unsigned n, unsigned x, unsigned y)
+    {
+        unsigned long long key = 0;
+        for (unsigned s = n / 2; s > 0; s /= 2)
+        {
+            unsigned rx = (x & s) > 0;
+            unsigned ry = (y & s) > 0;
+            key += static_cast<unsigned long long>(s) * s * ((3 * rx) ^ ry);
+
+            // rotate the quadrant
+            if (ry == 0)
+            {
+                if (rx == 1)
+                {
+                    x = s - 1 - x;
+                    y = s - 1 - y;
+                }
+                swap(x, y);
+            }
+        }
+        return key;
+    }
+}
+
+vector<Tile> makeTiles(unsigned width, unsigned height,
+                       unsigned tileSize, TileOrder order)
+{
+    tileSize = max(1U, tileSize);
+    unsigned cols = (width + tileSize - 1) / tileSize;
+    unsigned rows = (height + tileSize - 1) / tileSize;
+
+    // the curves are defined on a power of 2 grid covering all tiles
+    unsigned n = 1;
+    while (n < cols || n < rows)
+        n *= 2;
+
+    vector<pair<unsigned long long, Tile>> keyed;
+    keyed.reserve(cols * rows);
+    for (unsigned ty = 0; ty != rows; ++ty)
+        for (unsigned tx = 0; tx != cols; ++tx)
+        {
+            Tile tile{tx * tileSize, ty * tileSize,
+                      min(width, (tx + 1) * tileSize),
+                      min(height, (ty + 1) * tileSize)};
+
+            unsigned long long key = static_cast<unsigned long long>(ty) * cols + tx;
+            if (order == TileOrder::MORTON)
+                key = mortonKey(tx, ty);
+            else if (order == TileOrder::HILBERT)
+                key = hilbertKey(n, tx, ty);
+            keyed.push_back(make_pair(key, tile));
+        }
+
+    stable_sort(keyed.begin(), keyed.end(),
+                [](pair<unsigned long long, Tile> const &lhs,
+                   pair<unsigned long long, Tile> const &rhs)
+                {
+                    return lhs.first < rhs.first;
+                });
+
+    vector<Tile> tiles;
+    tiles.reserve(keyed.size());
+    for (auto const &entry : keyed)
+        tiles.push_back(entry.second);
+    return tiles;
+}
+
+TileOrder parseTileOrder(string const &name)
+{
+    if (name == "scanline")
+        return TileOrder::SCANLINE;
+    if (name == "morton")
+        return TileOrder::MORTON;
+    if (name == "hilbert")
+        return TileOrder::HILBERT;
+    throw runtime_error("Unknown tile order: " + name);
+}
+
+void writeTileStats(ostream &os, vector<TileStats> const &stats)
+{
+    os << "x0,y0,x1,y1,worker,seconds\n";
+    for (TileStats const &entry : stats)
+        os << entry.tile.x0 << ',' << entry.tile.y0 << ','
+           << entry.tile.x1 << ',' << entry.tile.y1 << ','
+           << entry.worker << ',' << entry.seconds << '\n';
+}
+
+void printTileSummary(ostream &os, vector<TileStats> const &stats)
+{
+    if (stats.empty())
+        return;
+
+    vector<double> busy;
+    double slowest = 0.0;
+    for (TileStats const &entry : stats)
+    {
+        if (entry.worker >= busy.size())
+            busy.resize(entry.worker + 1, 0.0);
+        busy[entry.worker] += entry.seconds;
+        slowest = max(slowest, entry.seconds);
+    }
+
+    double total = 0.0;
+    for (double seconds : busy)
+        total += seconds;
+    double mean = total / busy.size();
+    double most = *max_element(busy.begin(), busy.end());
+
+    os << stats.size() << " tiles on " << busy.size() << " threads, "
+       << "busy time per thread " << *min_element(busy.begin(), busy.end())
+       << " - " << most << " s (imbalance " << (mean > 0 ? most / mean : 1.0)
+       << "), slowest tile " << slowest << " s\n";
+}
+
+TileProgress printTileProgress(ostream &os, bool rewrite)
+{
+    unsigned const step = rewrite ? 1 : 10;
+    unsigned shown = 0;     // steps shown, + 1
+    return [&os, rewrite, step, shown](unsigned done, unsigned total) mutable
+    {
+        unsigned percent = total == 0 ? 100 : 100ULL * done / total;
+        if (percent / step + 1 == shown)
+            return;
+        shown = percent / step + 1;
+        os << (rewrite ? "\r" : "") << "Tracing: " << percent << "% ("
+           << done << '/' << total << " tiles)";
+        if (!rewrite || done == total)
+            os << '\n';
+        os.flush();
+    };
+}
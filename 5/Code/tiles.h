@@ -0,0 +1,55 @@
+#ifndef TILES_H_
+#define TILES_H_
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+// The image is rendered in square tiles, the unit of work of the render
+// threads. The order of the tiles determines which tiles a thread renders
+// one after the other; space filling curves keep those close together.
+
+enum class TileOrder
+{
+    SCANLINE,
+    MORTON,     // Z-order curve
+    HILBERT
+};
+
+struct Tile
+{
+    unsigned x0, y0;    // first pixel
+    unsigned x1, y1;    // one past the last pixel
+};
+
+// timing of one rendered tile
+struct TileStats
+{
+    Tile tile;
+    unsigned worker;
+    double seconds;
+};
+
+// called with the number of tiles finished and the total while tiles are
+// rendered, one call at a time
+typedef std::function<void(unsigned done, unsigned total)> TileProgress;
+
+// tiles covering a width x height image, in the given order
+std::vector<Tile> makeTiles(unsigned width, unsigned height,
+                            unsigned tileSize, TileOrder order);
+
+// "scanline", "morton" or "hilbert", throws on anything else
+TileOrder parseTileOrder(std::string const &name);
+
+// one line per tile: x0,y0,x1,y1,worker,seconds
+void writeTileStats(std::ostream &os, std::vector<TileStats> const &stats);
+
+// busy time per worker and the imbalance between them
+void printTileSummary(std::ostream &os, std::vector<TileStats> const &stats);
+
+// prints "Tracing: 40% (1000/2500 tiles)" to os, rewriting one line at
+// every percent if rewrite (a terminal), else a line every 10 percent
+TileProgress printTileProgress(std::ostream &os, bool rewrite);
+
+#endif
@@ -0,0 +1,181 @@
+#include "transform.h"
+
+#include "json/json.h"
+
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+using json = nlohmann::json;
+
+Transform::Transform()
+:
+    d_m{{1, 0, 0, 0},
+        {0, 1, 0, 0},
+        {0, 0, 1, 0}}
+{}
+
+Transform::Transform(json const &node)
+:
+    Transform(Placement(node).transform())
+{}
+
+Transform Transform::place(Vector const &offset, Vector const &angles,
+                           Vector const &factors)
+{
+    Transform result = scale(factors);
+    for (unsigned axis = 0; axis != 3; ++axis)
+        if (angles.data[axis] != 0)
+            result = rotation(axis, angles.data[axis]) * result;
+    return translation(offset) * result;
+}
+
+Transform Transform::translation(Vector const &offset)
+{
+    Transform result;
+    for (unsigned row = 0; row != 3; ++row)
+        result.d_m[row][3] = offset.data[row];
+    return result;
+}
+
+Transform Transform::scale(Vector const &factors)
+{
+    Transform result;
+    for (unsigned row = 0; row != 3; ++row)
+        result.d_m[row][row] = factors.data[row];
+    return result;
+}
+
+Transform Transform::rotation(unsigned axis, Real degrees)
+{
+    Real radians = degrees * M_PI / 180.0;
+    Real c = cos(radians);
+    Real s = sin(radians);
+    unsigned u = (axis + 1) % 3;    // the rotation turns u towards v
+    unsigned v = (axis + 2) % 3;
+
+    Transform result;
+    result.d_m[u][u] = c;
+    result.d_m[u][v] = -s;
+    result.d_m[v][u] = s;
+    result.d_m[v][v] = c;
+    return result;
+}
+
+Transform Transform::operator*(Transform const &other) const
+{
+    Transform result;
+    for (unsigned row = 0; row != 3; ++row)
+        for (unsigned col = 0; col != 4; ++col)
+        {
+            Real sum = col == 3 ? d_m[row][3] : 0;
+            for (unsigned k = 0; k != 3; ++k)
+                sum += d_m[row][k] * other.d_m[k][col];
+            result.d_m[row][col] = sum;
+        }
+    return result;
+}
+
+Transform Transform::inverse() const
+{
+    // inverse of the linear part by cofactors
+    Real const (*m)[4] = d_m;
+    Real c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+    Real c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+    Real c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+    Real det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+    if (det == 0)
+        throw runtime_error("Transform: matrix is not invertible");
+
+    Real invDet = 1 / det;
+    Transform result;
+    Real (*r)[4] = result.d_m;
+    r[0][0] = c00 * invDet;
+    r[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * invDet;
+    r[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * invDet;
+    r[1][0] = c01 * invDet;
+    r[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * invDet;
+    r[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * invDet;
+    r[2][0] = c02 * invDet;
+    r[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * invDet;
+    r[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * invDet;
+
+    // the translation undoes the original one: -inverse(L) * t
+    for (unsigned row = 0; row != 3; ++row)
+        r[row][3] = -(r[row][0] * m[0][3] + r[row][1] * m[1][3]
+                      + r[row][2] * m[2][3]);
+    return result;
+}
+
+Point Transform::point(Point const &p) const
+{
+    return vector(p) + Vector(d_m[0][3], d_m[1][3], d_m[2][3]);
+}
+
+Vector Transform::vector(Vector const &v) const
+{
+    return Vector(d_m[0][0] * v.x + d_m[0][1] * v.y + d_m[0][2] * v.z,
+                  d_m[1][0] * v.x + d_m[1][1] * v.y + d_m[1][2] * v.z,
+                  d_m[2][0] * v.x + d_m[2][1] * v.y + d_m[2][2] * v.z);
+}
+
+Vector Transform::normal(Vector const &N) const
+{
+    return Vector(d_m[0][0] * N.x + d_m[1][0] * N.y + d_m[2][0] * N.z,
+                  d_m[0][1] * N.x + d_m[1][1] * N.y + d_m[2][1] * N.z,
+                  d_m[0][2] * N.x + d_m[1][2] * N.y + d_m[2][2] * N.z);
+}
+
+Ray Transform::ray(Ray const &ray) const
+{
+    return Ray(point(ray.O), vector(ray.D));
+}
+
+AABB Transform::box(AABB const &box) const
+{
+    // Arvo: per axis, the extremes of each matrix entry times the extent
+    AABB result;
+    if (box.isEmpty())
+        return result;      // the infinities would give NaNs
+    for (unsigned row = 0; row != 3; ++row)
+    {
+        Real lower = d_m[row][3];
+        Real upper = d_m[row][3];
+        for (unsigned col = 0; col != 3; ++col)
+        {
+            Real a = d_m[row][col] * box.min.data[col];
+            Real b = d_m[row][col] * box.max.data[col];
+            lower += min(a, b);
+            upper += max(a, b);
+        }
+        result.min.data[row] = lower;
+        result.max.data[row] = upper;
+    }
+    return result;
+}
+
+// --- Placement ---------------------------------------------------------------
+
+Placement::Placement(json const &node)
+{
+    if (node.count("scale"))
+    {
+        json const &factors = node["scale"];
+        if (factors.is_array())
+            scale = Vector(factors);
+        else
+        {
+            Real factor = factors;
+            scale = Vector(factor, factor, factor);
+        }
+    }
+    if (node.count("rotation"))
+        rotation = Vector(node["rotation"]);
+    if (node.count("translation"))
+        translation = Vector(node["translation"]);
+}
+
+Transform Placement::transform() const
+{
+    return Transform::place(translation, rotation, scale);
+}
@@ -0,0 +1,65 @@
+#ifndef TRANSFORM_H_
+#define TRANSFORM_H_
+
+#include "aabb.h"
+#include "ray.h"
+#include "triple.h"
+
+#include "json/json_fwd.h"
+
+// Affine transformation: a 3 x 3 linear part (rotation, non-uniform
+// scale, shear) followed by a translation, stored as the rows of a 3 x 4
+// matrix. Used to place mesh instances in the scene.
+class Transform
+{
+    Real d_m[3][4];
+
+    public:
+        Transform();                            // identity
+
+        // "translation": [x, y, z], "rotation": [x, y, z] (degrees about
+        // the x, then the y, then the z axis) and "scale": s or [x, y, z],
+        // all optional. The scale is applied first, the translation last.
+        explicit Transform(nlohmann::json const &node);
+
+        // the same from the three parts, e.g. of an animation
+        static Transform place(Vector const &translation,
+                               Vector const &rotation, Vector const &scale);
+
+        static Transform translation(Vector const &offset);
+        static Transform scale(Vector const &factors);
+        static Transform rotation(unsigned axis, Real degrees);
+
+        // this after other: (a * b).point(p) == a.point(b.point(p))
+        Transform operator*(Transform const &other) const;
+
+        // throws if the linear part is singular (e.g. a zero scale)
+        Transform inverse() const;
+
+        Point point(Point const &p) const;
+        Vector vector(Vector const &v) const;   // no translation
+
+        // The transposed linear part. Normals transform by the inverse
+        // transpose, so inverse().normal(N) maps an object space normal to
+        // world space (not normalized).
+        Vector normal(Vector const &N) const;
+
+        Ray ray(Ray const &ray) const;          // D keeps its scale: the
+                                                // distance t is preserved
+        AABB box(AABB const &box) const;        // bounds of the moved box
+};
+
+// The parts of a Transform as read from JSON, kept to animate them
+struct Placement
+{
+    Vector translation = Vector(0, 0, 0);
+    Vector rotation = Vector(0, 0, 0);     // degrees about x, y, z
+    Vector scale = Vector(1, 1, 1);
+
+    Placement() = default;
+    explicit Placement(nlohmann::json const &node);     // as Transform
+
+    Transform transform() const;
+};
+
+#endif
@@ -1,100 +1,296 @@
 #ifndef TRIPLE_H_
 #define TRIPLE_H_
 
+#include "real.h"
+
 #include "json/json_fwd.h"
 
+#include <cmath>
 #include <iosfwd>
 
-// Color, Point and Vector are all Triples (name them so)
-class Triple;
-typedef Triple Color;
-typedef Triple Point;
-typedef Triple Vector;
+// Three component vector of float or double. Everything but the JSON
+// constructor and the IO operators is defined here, so the arithmetic in
+// the intersection code inlines instead of calling out of line functions.
+//
+// With Padded (the default when VEC3_PADDED is defined) a fourth, unused
+// component w pads the vector to 4 elements aligned to 16 bytes: a float
+// vector then fills exactly one SSE/NEON register.
+
+#ifdef VEC3_PADDED
+#define VEC3_PADDED_DEFAULT true
+#else
+#define VEC3_PADDED_DEFAULT false
+#endif
 
-class Triple
+template <typename T, bool Padded>
+struct Vec3Data
 {
-    public:
-// --- data members ------------------------------------------------------------
-
-        // union to acces the same elements by
-        // x, y, z, or r, g, b or data[index]
-        union {
-            double data[3];
-            struct {
-                double x;
-                double y;
-                double z;
-            };
-            struct {
-                double r;
-                double g;
-                double b;
-            };
+    // union to acces the same elements by
+    // x, y, z, or r, g, b or data[index]
+    union {
+        T data[3];
+        struct {
+            T x;
+            T y;
+            T z;
+        };
+        struct {
+            T r;
+            T g;
+            T b;
         };
+    };
+
+    constexpr Vec3Data(T X, T Y, T Z)
+    :
+        x(X),
+        y(Y),
+        z(Z)
+    {}
+};
+
+template <typename T>
+struct alignas(16) Vec3Data<T, true>
+{
+    union {
+        T data[4];
+        struct {
+            T x;
+            T y;
+            T z;
+            T w;        // padding, always 0
+        };
+        struct {
+            T r;
+            T g;
+            T b;
+        };
+    };
+
+    constexpr Vec3Data(T X, T Y, T Z)
+    :
+        x(X),
+        y(Y),
+        z(Z),
+        w(0)
+    {}
+};
+
+template <typename T, bool Padded = VEC3_PADDED_DEFAULT>
+class Vec3: public Vec3Data<T, Padded>
+{
+    public:
+        typedef T value_type;
+
+        using Vec3Data<T, Padded>::x;
+        using Vec3Data<T, Padded>::y;
+        using Vec3Data<T, Padded>::z;
 
 // --- Constructors ------------------------------------------------------------
 
-        explicit Triple(double X = 0, double Y = 0, double Z = 0);
-        explicit Triple(nlohmann::json const &node);    // json -> Triple
+        constexpr explicit Vec3(T X = 0, T Y = 0, T Z = 0)
+        :
+            Vec3Data<T, Padded>(X, Y, Z)
+        {}
+
+        explicit Vec3(nlohmann::json const &node);      // json -> Vec3
 
 // --- Operators ---------------------------------------------------------------
 
-        Triple operator+(Triple const &t) const;// add two triples
-        Triple operator+(double f) const;       // add a value to each member
-                                                // of a triple
-        Triple operator-() const;               // negate
-        Triple operator-(Triple const &t) const;// subtract two triples
-        Triple operator-(double f) const;       // subtract a value from each
-                                                // member
+        constexpr Vec3 operator+(Vec3 const &t) const   // add two triples
+        {
+            return Vec3(x + t.x, y + t.y, z + t.z);
+        }
+
+        constexpr Vec3 operator+(T f) const     // add a value to each member
+        {                                       // of a triple
+            return Vec3(x + f, y + f, z + f);
+        }
+
+        constexpr Vec3 operator-() const        // negate
+        {
+            return Vec3(-x, -y, -z);
+        }
+
+        constexpr Vec3 operator-(Vec3 const &t) const   // subtract two triples
+        {
+            return Vec3(x - t.x, y - t.y, z - t.z);
+        }
 
-        Triple operator*(Triple const &t) const;// memberwise multiplication
-        Triple operator*(double f) const;       // multiply each member with a
-                                                // value
-        Triple operator/(double f) const;       // divide each member by a value
+        constexpr Vec3 operator-(T f) const     // subtract a value from each
+        {                                       // member
+            return Vec3(x - f, y - f, z - f);
+        }
+
+        constexpr Vec3 operator*(Vec3 const &t) const   // memberwise
+        {                                               // multiplication
+            return Vec3(x * t.x, y * t.y, z * t.z);
+        }
+
+        constexpr Vec3 operator*(T f) const     // multiply each member with a
+        {                                       // value
+            return Vec3(x * f, y * f, z * f);
+        }
+
+        constexpr Vec3 operator/(T f) const     // divide each member by a value
+        {
+            return *this * (1 / f);
+        }
 
 // --- Compound operators ------------------------------------------------------
 
-        Triple &operator+=(Triple const &t);
-        Triple &operator+=(double f);
+        constexpr Vec3 &operator+=(Vec3 const &t)
+        {
+            x += t.x;
+            y += t.y;
+            z += t.z;
+            return *this;
+        }
+
+        constexpr Vec3 &operator+=(T f)
+        {
+            x += f;
+            y += f;
+            z += f;
+            return *this;
+        }
+
+        constexpr Vec3 &operator-=(Vec3 const &t)
+        {
+            x -= t.x;
+            y -= t.y;
+            z -= t.z;
+            return *this;
+        }
+
+        constexpr Vec3 &operator-=(T f)
+        {
+            x -= f;
+            y -= f;
+            z -= f;
+            return *this;
+        }
 
-        Triple &operator-=(Triple const &t);
-        Triple &operator-=(double f);
+        constexpr Vec3 &operator*=(T f)
+        {
+            x *= f;
+            y *= f;
+            z *= f;
+            return *this;
+        }
 
-        Triple &operator*=(double f);
-        Triple &operator/=(double f);
+        constexpr Vec3 &operator/=(T f)
+        {
+            return *this *= 1 / f;
+        }
 
 // --- Vector Operators --------------------------------------------------------
 
-        double dot(Triple const &t) const;      // dot product
-        Triple cross(Triple const &t) const;    // cross product
+        constexpr T dot(Vec3 const &t) const    // dot product
+        {
+            return x * t.x + y * t.y + z * t.z;
+        }
 
-        double length() const;
-        double length_2() const;                // length squared
+        constexpr Vec3 cross(Vec3 const &t) const   // cross product
+        {
+            return Vec3(y*t.z - z*t.y,
+                        z*t.x - x*t.z,
+                        x*t.y - y*t.x);
+        }
+
+        T length() const
+        {
+            return std::sqrt(length_2());
+        }
+
+        constexpr T length_2() const            // length squared
+        {
+            return x * x + y * y + z * z;
+        }
 
         // NOTE: normalized return a COPY, normalize does NOT
-        Triple normalized() const;              // normalized COPY
-        void normalize();                       // normalize THIS
+        Vec3 normalized() const                 // normalized COPY
+        {
+            return *this / length();
+        }
+
+        void normalize()                        // normalize THIS
+        {
+            *this *= 1 / length();
+        }
 
 // --- Color functions ---------------------------------------------------------
 
-        void set(double f);                     // set all values to f
-        void set(double f, double maxValue);    // set all values to f / maxVal
-        void set(double red, double green, double blue);
-        void set(double red, double green, double blue, double maxValue);
+        constexpr void set(T f)                 // set all values to f
+        {
+            set(f, f, f);
+        }
 
-        void clamp(double maxValue = 1.0);      // clamp: fmin(val, maxValue)
+        constexpr void set(T f, T maxValue)     // set all values to f / maxVal
+        {
+            set(f / maxValue);
+        }
 
+        constexpr void set(T red, T green, T blue)
+        {
+            x = red;
+            y = green;
+            z = blue;
+        }
+
+        constexpr void set(T red, T green, T blue, T maxValue)
+        {
+            set(red / maxValue, green / maxValue, blue / maxValue);
+        }
+
+        void clamp(T maxValue = 1)              // clamp: fmin(val, maxValue)
+        {
+            x = std::fmin(x, maxValue);
+            y = std::fmin(y, maxValue);
+            z = std::fmin(z, maxValue);
+        }
 };
 
 // --- Free Operators ----------------------------------------------------------
 
-Triple operator+(double f, Triple const &t);
-Triple operator-(double f, Triple const &t);
-Triple operator*(double f, Triple const &t);
+// the scalar is not deduced, so 2 * v works for both float and double
+
+template <typename T, bool Padded>
+constexpr Vec3<T, Padded> operator+(typename Vec3<T, Padded>::value_type f,
+                                    Vec3<T, Padded> const &t)
+{
+    return Vec3<T, Padded>(f + t.x, f + t.y, f + t.z);
+}
+
+template <typename T, bool Padded>
+constexpr Vec3<T, Padded> operator-(typename Vec3<T, Padded>::value_type f,
+                                    Vec3<T, Padded> const &t)
+{
+    return Vec3<T, Padded>(f - t.x, f - t.y, f - t.z);
+}
+
+template <typename T, bool Padded>
+constexpr Vec3<T, Padded> operator*(typename Vec3<T, Padded>::value_type f,
+                                    Vec3<T, Padded> const &t)
+{
+    return Vec3<T, Padded>(f * t.x, f * t.y, f * t.z);
+}
 
 // --- IO Operators ------------------------------------------------------------
 
-std::istream &operator>>(std::istream &is, Triple &t);
-std::ostream &operator<<(std::ostream &os, Triple const &t);
+template <typename T, bool Padded>
+std::istream &operator>>(std::istream &is, Vec3<T, Padded> &t);
+
+template <typename T, bool Padded>
+std::ostream &operator<<(std::ostream &os, Vec3<T, Padded> const &t);
+
+// Color, Point and Vector are all Triples (name them so)
+typedef Vec3<float> Vec3f;
+typedef Vec3<double> Vec3d;
+
+typedef Vec3<Real> Triple;
+typedef Triple Color;
+typedef Triple Point;
+typedef Triple Vector;
 
 #endif
@@ -0,0 +1,57 @@
+#include "wavefront.h"
+
+#include "aabb.h"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+namespace
+{
+    // interleave the low 4 bits of x, y and z
+    uint32_t mortonKey(uint32_t x, uint32_t y, uint32_t z)
+    {
+        uint32_t key = 0;
+        for (unsigned bit = 0; bit != 4; ++bit)
+        {
+            key |= ((x >> bit) & 1U) << (3 * bit);
+            key |= ((y >> bit) & 1U) << (3 * bit + 1);
+            key |= ((z >> bit) & 1U) << (3 * bit + 2);
+        }
+        return key;
+    }
+}
+
+void coherentOrder(vector<Ray> const &rays, vector<unsigned> &order)
+{
+    AABB box;
+    for (Ray const &ray : rays)
+        box.extend(ray.O);
+
+    // the key in the high half, the index in the low half
+    vector<uint64_t> keys(rays.size());
+    for (unsigned idx = 0; idx != rays.size(); ++idx)
+    {
+        Ray const &ray = rays[idx];
+        uint32_t cell[3];
+        for (unsigned axis = 0; axis != 3; ++axis)
+        {
+            Real extent = box.max.data[axis] - box.min.data[axis];
+            Real scaled = extent > 0
+                ? (ray.O.data[axis] - box.min.data[axis]) / extent
+                  * WAVEFRONT_CELLS
+                : 0;
+            cell[axis] = min(uint32_t(scaled), uint32_t(WAVEFRONT_CELLS - 1));
+        }
+        uint32_t octant = (ray.D.x < 0) | (ray.D.y < 0) << 1
+                          | (ray.D.z < 0) << 2;
+        uint32_t key = octant << 12 | mortonKey(cell[0], cell[1], cell[2]);
+        keys[idx] = uint64_t(key) << 32 | idx;
+    }
+    sort(keys.begin(), keys.end());
+
+    order.resize(rays.size());
+    for (unsigned idx = 0; idx != rays.size(); ++idx)
+        order[idx] = uint32_t(keys[idx]);
+}
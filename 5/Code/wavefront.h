@@ -0,0 +1,24 @@
+#ifndef WAVEFRONT_H_
+#define WAVEFRONT_H_
+
+#include "ray.h"
+
+#include <vector>
+
+// The wavefront integrator (ray --wavefront) traces the rays of a tile
+// bounce by bounce instead of path by path: all primary rays, then all
+// shadow rays of their hits, then all reflected rays and so on. Before a
+// batch of secondary rays is traced it is put in coherent order: by the
+// octant of the direction, then by the cell of the origin in a
+// CELLS x CELLS x CELLS grid over the origins of the batch, the cells
+// along a Morton curve. Rays that start close together and head the same
+// way visit the same BVH nodes and triangles, tracing them one after the
+// other keeps those in cache.
+
+enum { WAVEFRONT_CELLS = 16 };
+
+// the indices of rays in coherent order
+void coherentOrder(std::vector<Ray> const &rays,
+                   std::vector<unsigned> &order);
+
+#endif